@@ -0,0 +1,31 @@
+// legacy_levenshtein.hpp
+// The full-table levenshtein() that levenshtein.hpp replaced, kept as the
+// baseline for bench/levenshtein_bench.cpp and the reference for
+// tests/levenshtein_test.cpp.
+#ifndef NABRETERM_LEGACY_LEVENSHTEIN_HPP
+#define NABRETERM_LEGACY_LEVENSHTEIN_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+inline int legacyLevenshtein(const std::string& a, const std::string& b) {
+    int n = a.size(), m = b.size();
+    std::vector<std::vector<int>> dp(n+1, std::vector<int>(m+1));
+
+    for (int i = 0; i <= n; i++) dp[i][0] = i;
+    for (int j = 0; j <= m; j++) dp[0][j] = j;
+
+    for (int i = 1; i <= n; i++) {
+        for (int j = 1; j <= m; j++) {
+            int cost = (tolower(a[i-1]) == tolower(b[j-1])) ? 0 : 1;
+            dp[i][j] = std::min({ dp[i-1][j] + 1,     // deletion
+                dp[i][j-1] + 1,     // insertion
+                dp[i-1][j-1] + cost }); // substitution
+        }
+    }
+    return dp[n][m];
+}
+
+#endif // NABRETERM_LEGACY_LEVENSHTEIN_HPP
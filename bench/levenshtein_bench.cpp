@@ -0,0 +1,112 @@
+// levenshtein_bench.cpp
+// Microbenchmark: the bounded edit-distance kernel against the original
+// full-table levenshtein(), on words taken from the corpus.
+//
+// Usage: levenshtein_bench [nabre.bin|nabre.json] [queries] [candidates]
+
+#include "../corpus.hpp"
+#include "../levenshtein.hpp"
+#include "legacy_levenshtein.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+template <class Fn>
+static double timeNs(Fn fn, size_t& hits) {
+    auto start = chrono::steady_clock::now();
+    hits = fn();
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    Corpus corpus;
+    bool loaded = false;
+    if (argc >= 2) {
+        string path = argv[1];
+        loaded = path.size() > 4 && path.compare(path.size() - 4, 4, ".bin") == 0
+            ? corpus.loadBinary(path) : corpus.loadJson(path);
+    } else {
+        loaded = loadCorpus(corpus);
+    }
+    if (!loaded) {
+        cerr << "Could not load corpus.\n";
+        return 1;
+    }
+    size_t queryCount = argc >= 3 ? stoul(argv[2]) : 200;
+    size_t candidateCount = argc >= 4 ? stoul(argv[3]) : 5000;
+
+    // Distinct lowercase words, as seen by the search fuzzy fallback
+    unordered_set<string> seen;
+    vector<string> words;
+    string word;
+    for (uint32_t v = 0; v < corpus.verseCount(); v++) {
+        for (char c : corpus.verseText(v)) {
+            if (isspace((unsigned char)c)) {
+                if (!word.empty() && seen.insert(word).second) words.push_back(word);
+                word.clear();
+            } else {
+                word.push_back(tolower((unsigned char)c));
+            }
+        }
+        if (!word.empty() && seen.insert(word).second) words.push_back(word);
+        word.clear();
+    }
+    if (words.empty()) {
+        cerr << "Corpus has no words.\n";
+        return 1;
+    }
+
+    // Queries: corpus words, a third of them with one typo
+    mt19937 rng(42);
+    vector<string> queries, candidates;
+    for (size_t i = 0; i < queryCount; i++) {
+        string q = words[rng() % words.size()];
+        if (i % 3 == 0 && q.size() > 1) q[rng() % q.size()] = 'a' + rng() % 26;
+        queries.push_back(q);
+    }
+    for (size_t i = 0; i < candidateCount; i++) candidates.push_back(words[rng() % words.size()]);
+
+    size_t legacyHits = 0, boundedHits = 0, batchedHits = 0;
+    double legacyNs = timeNs([&] {
+        size_t hits = 0;
+        for (auto& q : queries)
+            for (auto& c : candidates) hits += legacyLevenshtein(c, q) <= 2;
+        return hits;
+    }, legacyHits);
+    double boundedNs = timeNs([&] {
+        size_t hits = 0;
+        for (auto& q : queries)
+            for (auto& c : candidates) hits += levenshtein(c, q, 2) <= 2;
+        return hits;
+    }, boundedHits);
+    double batchedNs = timeNs([&] {
+        size_t hits = 0;
+        for (auto& q : queries) {
+            LevenshteinPattern pattern(q);
+            for (auto& c : candidates) hits += pattern.distance(c, 2) <= 2;
+        }
+        return hits;
+    }, batchedHits);
+
+    double pairs = double(queries.size()) * candidates.size();
+    cout << "vocabulary words: " << words.size() << ", pairs: " << (size_t)pairs << "\n";
+    cout << "legacy  full table : " << legacyNs / pairs << " ns/pair (" << legacyHits << " within 2)\n";
+    cout << "bounded single     : " << boundedNs / pairs << " ns/pair (" << boundedHits << " within 2), "
+         << legacyNs / boundedNs << "x\n";
+    cout << "bounded batched    : " << batchedNs / pairs << " ns/pair (" << batchedHits << " within 2), "
+         << legacyNs / batchedNs << "x\n";
+
+    if (legacyHits != boundedHits || legacyHits != batchedHits) {
+        cerr << "Mismatch between kernels!\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,547 @@
+// nabreterm_bench.cpp
+// End-to-end benchmark of nabreterm's stages on synthetic corpora, with the
+// results written as JSON so runs can be diffed across commits.
+//
+// Usage:
+//   nabreterm_bench [--scales 1,10,100] [--iterations N] [--load-iterations N]
+//                   [--threads N] [--seed N] [--dir DIR] [--corpus FILE] [-o FILE]
+//   nabreterm_bench --generate SCALE [--seed N] [-o FILE]
+//
+// Each scale's corpus is generated in the nabre.json schema (1x is about the
+// size of the NABRE: 73 books, ~1300 chapters, ~35k verses; Nx has N times
+// the chapters per book) and kept in DIR as bench_corpus_<N>x.json, so later
+// runs reuse it; delete the file to regenerate. --corpus benchmarks a given
+// file instead. Stages, timed per call in microseconds:
+//   load_json, load_bin      cold Corpus load of the JSON and nabre.bin
+//   load_json_book           one random book through the sidecar offsets
+//                            (a one-shot lookup without nabre.bin)
+//   build_references         ReferenceIndex::build
+//   build_search_index       SearchIndex::build
+//   reference                runChapter/runRange on random references
+//   search_term              one keyword, common to rare
+//   search_boolean           &&, || and ! over two keywords
+//   search_fuzzy             misspelled keywords (fuzzy fallback)
+//   search_positional        "two word" phrases and NEAR/5
+//   search_ranked            keywords, BM25 top 10 (--ranked --limit 10)
+//   search_cached            search_boolean again with the result cache on
+//                            (other search stages run with it off)
+//   random                   runRandom with and without a scope
+//   build_folded_text        FoldedText::build (nabretermui, SearchIndex)
+//   tui_search               FoldedText scan of the whole corpus, as typed
+//   load_nbz                 cold load of the block-compressed nabre.nbz
+//   chapter_nbz              inflate one random chapter of it
+//   scan_nbz                 streaming pass over all its verses
+//   build_search_index_nbz   SearchIndex::build, streaming from it
+// Output goes to sinks, so formatting is timed but not terminal I/O.
+
+#include "../commands.hpp"
+#include "../json_reader.hpp"
+#include "../text_scan.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// --- Synthetic corpus in the nabre.json schema ---
+
+// Book names from books.json, or Book1..Book73 without it
+static vector<string> benchBookNames() {
+    vector<string> names;
+    string error;
+    if (readStringArray("books.json", names, error)) return names;
+    names.clear();
+    for (int i = 1; i <= 73; i++) names.push_back("Book" + to_string(i));
+    return names;
+}
+
+// A fixed head of common words followed by pronounceable made-up ones;
+// words are drawn with Zipf weights so posting lists look like real text
+class SyntheticVocabulary {
+public:
+    explicit SyntheticVocabulary(mt19937& rng, size_t size = 12000) {
+        words_ = { "the", "and", "of", "to", "that", "in", "he", "shall", "unto", "for", "his", "lord",
+                   "they", "be", "is", "him", "not", "them", "with", "all", "god", "was", "which", "said",
+                   "people", "israel", "king", "house", "land", "son", "day", "heaven", "earth", "spirit",
+                   "love", "faith", "hope", "light", "word", "life", "peace", "glory", "mercy", "truth",
+                   "kingdom", "father", "jesus", "christ", "covenant", "temple", "prayer", "blessed" };
+        const char* onsets[] = { "b", "br", "ch", "d", "dr", "f", "g", "gr", "h", "j", "k", "l", "m", "n",
+                                 "p", "r", "s", "sh", "st", "t", "th", "tr", "v", "w", "z" };
+        const char* vowels[] = { "a", "e", "i", "o", "u", "ai", "ea", "ou" };
+        unordered_set<string> seen(words_.begin(), words_.end());
+        while (words_.size() < size) {
+            string w;
+            int syllables = 1 + rng() % 3;
+            for (int s = 0; s < syllables; s++) {
+                w += onsets[rng() % size_t(sizeof onsets / sizeof *onsets)];
+                w += vowels[rng() % size_t(sizeof vowels / sizeof *vowels)];
+            }
+            if (rng() % 2) w += onsets[rng() % size_t(sizeof onsets / sizeof *onsets)];
+            if (seen.insert(w).second) words_.push_back(w);
+        }
+        double total = 0;
+        for (size_t r = 0; r < words_.size(); r++) {
+            total += 1.0 / (r + 1);
+            cumulative_.push_back(total);
+        }
+    }
+
+    const string& draw(mt19937& rng) const {
+        double x = uniform_real_distribution<double>(0, cumulative_.back())(rng);
+        size_t r = upper_bound(cumulative_.begin(), cumulative_.end(), x) - cumulative_.begin();
+        return words_[min(r, words_.size() - 1)];
+    }
+
+private:
+    vector<string> words_;
+    vector<double> cumulative_;
+};
+
+static bool generateCorpus(const string& path, int scale, unsigned seed) {
+    ofstream file(path, ios::binary);
+    if (!file.is_open()) {
+        cerr << "Could not write " << path << "\n";
+        return false;
+    }
+    mt19937 rng(seed);
+    SyntheticVocabulary vocabulary(rng);
+    vector<string> books = benchBookNames();
+
+    string buf = "[";
+    for (size_t b = 0; b < books.size(); b++) {
+        buf += b ? ",{\"book\":" : "{\"book\":";
+        appendQuoted(buf, books[b]);
+        buf += ",\"chapters\":[";
+        int chapters = (1 + rng() % 35) * scale;
+        for (int c = 1; c <= chapters; c++) {
+            buf += c > 1 ? ",{\"chapter\":" : "{\"chapter\":";
+            buf += to_string(c) + ",\"verses\":[";
+            int verses = 10 + rng() % 35;
+            for (int v = 1; v <= verses; v++) {
+                string text;
+                int words = 6 + rng() % 35;
+                for (int w = 0; w < words; w++) {
+                    if (w) text += rng() % 12 == 0 ? ", " : " ";
+                    text += vocabulary.draw(rng);
+                }
+                text[0] = toupper((unsigned char)text[0]);
+                text += rng() % 8 == 0 ? "?" : ".";
+                buf += v > 1 ? ",{\"verse\":" : "{\"verse\":";
+                buf += to_string(v) + ",\"text\":";
+                appendQuoted(buf, text);
+                buf += "}";
+            }
+            buf += "]}";
+            file.write(buf.data(), buf.size());
+            buf.clear();
+        }
+        buf += "]}";
+    }
+    buf += "]\n";
+    file.write(buf.data(), buf.size());
+    return bool(file);
+}
+
+// --- Timing ---
+
+// Discards everything written to it
+class NullBuffer : public streambuf {
+protected:
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+    int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+};
+
+struct StageResult {
+    string name;
+    vector<double> micros;
+};
+
+template <class Fn>
+static double timeMicros(Fn&& fn) {
+    auto start = chrono::steady_clock::now();
+    fn();
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)ceil(p / 100 * sorted.size());
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+static void appendNumber(string& out, double value) {
+    char text[32];
+    snprintf(text, sizeof text, "%.1f", value);
+    out += text;
+}
+
+static void appendStage(string& out, const StageResult& stage) {
+    vector<double> sorted = stage.micros;
+    sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (double us : sorted) sum += us;
+    out += "        {\"stage\":";
+    appendQuoted(out, stage.name);
+    out += ",\"samples\":" + to_string(sorted.size());
+    pair<const char*, double> fields[] = {
+        { "min_us", sorted.empty() ? 0 : sorted.front() },
+        { "mean_us", sorted.empty() ? 0 : sum / sorted.size() },
+        { "p50_us", percentile(sorted, 50) },
+        { "p90_us", percentile(sorted, 90) },
+        { "p99_us", percentile(sorted, 99) },
+        { "max_us", sorted.empty() ? 0 : sorted.back() },
+    };
+    for (auto& field : fields) {
+        out += ",\"" + string(field.first) + "\":";
+        appendNumber(out, field.second);
+    }
+    out += "}";
+}
+
+// --- Stages ---
+
+struct BenchOptions {
+    vector<int> scales = { 1, 10, 100 };
+    int iterations = 32;           // two passes over the 16 keywords
+    int loadIterations = 3;
+    unsigned threads = ThreadPool::defaultThreads();
+    unsigned seed = 42;
+    string dir = ".";
+    string corpus;
+};
+
+// Lowercase words of the corpus, most frequent first
+static vector<string> wordsByFrequency(const Corpus& bible) {
+    unordered_map<string, size_t> counts;
+    string word;
+    for (uint32_t v = 0; v < bible.verseCount(); v++) {
+        for (char c : bible.verseText(v)) {
+            if (isalpha((unsigned char)c)) {
+                word.push_back(asciiLower(c));
+            } else if (!word.empty()) {
+                counts[word]++;
+                word.clear();
+            }
+        }
+        if (!word.empty()) counts[word]++;
+        word.clear();
+    }
+    vector<pair<size_t, string>> ranked;
+    for (auto& entry : counts) ranked.emplace_back(entry.second, entry.first);
+    sort(ranked.begin(), ranked.end(), [](auto& a, auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    vector<string> words;
+    for (auto& entry : ranked) words.push_back(entry.second);
+    return words;
+}
+
+static vector<StageResult> benchCorpus(const string& jsonPath, const BenchOptions& options, string& summary) {
+    vector<StageResult> stages;
+    auto stage = [&](const string& name) -> StageResult& {
+        stages.push_back({ name, {} });
+        cerr << "  " << name << "\n";
+        return stages.back();
+    };
+
+    Corpus bible;
+    {
+        StageResult& s = stage("load_json");
+        for (int i = 0; i < options.loadIterations; i++) {
+            Corpus cold;
+            bool ok = true;
+            s.micros.push_back(timeMicros([&] { ok = cold.loadJson(jsonPath); }));
+            if (!ok) {
+                cerr << "Could not load " << jsonPath << "\n";
+                return {};
+            }
+        }
+    }
+    string binPath = jsonPath + ".bin";
+    {
+        Corpus parsed;
+        vector<JsonSpan> spans;
+        parsed.loadJson(jsonPath, &spans);
+        parsed.writeBinary(binPath);
+
+        vector<string> names;
+        for (uint32_t b = 0; b < parsed.bookCount(); b++) names.emplace_back(parsed.bookName(b));
+        mt19937_64 rng(options.seed);
+        StageResult& book = stage("load_json_book");
+        for (int i = 0; i < options.loadIterations; i++) {
+            Corpus cold;
+            uint32_t b = uint32_t(rng() % names.size());
+            book.micros.push_back(timeMicros([&] { cold.loadJsonBook(jsonPath, names, b, spans[b]); }));
+        }
+
+        StageResult& s = stage("load_bin");
+        for (int i = 0; i < options.loadIterations; i++) {
+            Corpus cold;
+            s.micros.push_back(timeMicros([&] { cold.loadBinary(binPath); }));
+        }
+        bible.loadBinary(binPath);
+    }
+
+    ReferenceIndex refs;
+    {
+        StageResult& s = stage("build_references");
+        for (int i = 0; i < options.loadIterations; i++) s.micros.push_back(timeMicros([&] { refs.build(bible); }));
+    }
+    SearchIndex index;
+    {
+        StageResult& s = stage("build_search_index");
+        for (int i = 0; i < options.loadIterations; i++) {
+            SearchIndex cold;
+            s.micros.push_back(timeMicros([&] { cold.build(bible); }));
+        }
+        index.build(bible);
+        index.cache().setBudget(0);   // search stages time evaluation; see search_cached
+    }
+
+    ThreadPool pool(options.threads - 1);
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    OutputWriter out(OutputFormat::Text, true, sink, sink);
+    mt19937 rng(options.seed);
+    const int n = options.iterations;
+
+    {
+        StageResult& s = stage("reference");
+        for (int i = 0; i < n; i++) {
+            uint32_t bi = rng() % bible.bookCount();
+            const BookRecord& b = bible.book(bi);
+            const ChapterRecord& ch = bible.chapter(b.firstChapter + rng() % b.chapterCount);
+            string book(bible.bookName(bi));
+            if (i % 2) {
+                s.micros.push_back(timeMicros([&] { runChapter(bible, refs, out, book, ch.number); }));
+            } else {
+                uint32_t first = 1 + rng() % ch.verseCount;
+                string verses = to_string(first) + "-" + to_string(first + rng() % 5);
+                s.micros.push_back(timeMicros([&] { runRange(bible, refs, out, book, ch.number, verses); }));
+            }
+        }
+    }
+
+    // Keywords spread from the most common words to rare ones
+    vector<string> words = wordsByFrequency(bible);
+    vector<string> keywords;
+    for (size_t rank = 1; rank < words.size() && keywords.size() < 16; rank = rank * 2 + 1) {
+        keywords.push_back(words[rank]);
+    }
+    if (keywords.empty()) {
+        cerr << "Corpus has no words.\n";
+        return {};
+    }
+    unordered_set<string> vocabulary(words.begin(), words.end());
+    vector<string> typos;
+    for (size_t k = 0; typos.size() < keywords.size() && k < keywords.size() * 8; k++) {
+        string typo = keywords[k % keywords.size()];
+        if (typo.size() < 4) continue;
+        typo[rng() % typo.size()] = 'a' + rng() % 26;
+        if (!vocabulary.count(typo)) typos.push_back(typo);
+    }
+
+    SearchOptions searchOptions;
+    auto searchStage = [&](const string& name, const vector<string>& queries) {
+        StageResult& s = stage(name);
+        for (int i = 0; i < n && !queries.empty(); i++) {
+            const string& query = queries[i % queries.size()];
+            s.micros.push_back(timeMicros([&] { searchEngine(bible, index, pool, searchOptions, out, query); }));
+        }
+    };
+    searchStage("search_term", keywords);
+    vector<string> boolean;
+    for (size_t k = 0; k + 1 < keywords.size(); k++) {
+        const char* op = k % 3 == 0 ? " && " : k % 3 == 1 ? " || " : " && !";
+        boolean.push_back(keywords[k] + op + keywords[k + 1]);
+    }
+    searchStage("search_boolean", boolean);
+    searchStage("search_fuzzy", typos);
+    vector<string> positional;
+    for (size_t k = 0; k + 1 < keywords.size(); k++) {
+        positional.push_back(k % 2 ? keywords[k] + " NEAR/5 " + keywords[k + 1]
+                                   : "\"" + keywords[k] + " " + keywords[k + 1] + "\"");
+    }
+    searchStage("search_positional", positional);
+    searchOptions.ranked = true;
+    searchOptions.limit = 10;
+    searchStage("search_ranked", keywords);
+    searchOptions = SearchOptions();
+    index.cache().setBudget(QueryCache<CachedEvaluation>::DEFAULT_BUDGET);
+    searchStage("search_cached", boolean);
+
+    {
+        StageResult& s = stage("random");
+        vector<vector<string>> commands = { { "random" }, { "random", "3" }, { "random", "NT" },
+                                            { "random", "2", "Psalms" } };
+        VerseSampler sampler(options.seed);
+        sampler.build(bible);
+        addRandomScopes(bible, sampler);
+        for (int i = 0; i < n; i++) {
+            const vector<string>& tokens = commands[i % commands.size()];
+            s.micros.push_back(timeMicros([&] { runRandom(bible, refs, sampler, out, tokens); }));
+        }
+    }
+
+    FoldedText folded;
+    {
+        StageResult& s = stage("build_folded_text");
+        for (int i = 0; i < options.loadIterations; i++) s.micros.push_back(timeMicros([&] { folded.build(bible); }));
+    }
+    {
+        // Every prefix of each keyword, as search-as-you-type sees it
+        vector<string> typed;
+        for (auto& keyword : keywords) {
+            for (size_t len = 1; len <= keyword.size(); len++) typed.push_back(keyword.substr(0, len));
+        }
+        StageResult& s = stage("tui_search");
+        size_t matches = 0;
+        for (int i = 0; i < n; i++) {
+            const string& needle = typed[i % typed.size()];
+            s.micros.push_back(timeMicros([&] {
+                folded.forEachMatch(needle, 0, bible.verseCount(), [&](uint32_t) { matches++; });
+            }));
+        }
+    }
+
+    // The same corpus block-compressed: opening it, the one chapter a
+    // reference reads, and the full streaming passes of a search
+    string nbzPath = jsonPath + ".nbz";
+    bible.writeCompressed(nbzPath);
+    Corpus packed;
+    {
+        StageResult& s = stage("load_nbz");
+        for (int i = 0; i < options.loadIterations; i++) {
+            Corpus cold;
+            s.micros.push_back(timeMicros([&] { cold.loadCompressed(nbzPath); }));
+        }
+        packed.loadCompressed(nbzPath);
+    }
+    {
+        StageResult& s = stage("chapter_nbz");
+        size_t bytes = 0;
+        vector<uint32_t> verses;
+        for (int i = 0; i < n; i++) {
+            const ChapterRecord& ch = packed.chapter(rng() % packed.chapterCount());
+            verses.clear();
+            for (uint32_t v = ch.firstVerse; v < ch.firstVerse + ch.verseCount; v++) verses.push_back(v);
+            s.micros.push_back(timeMicros([&] {
+                packed.forEachVerseText([&](uint32_t, string_view text) { bytes += text.size(); }, &verses);
+            }));
+        }
+    }
+    {
+        StageResult& s = stage("scan_nbz");
+        size_t bytes = 0;
+        for (int i = 0; i < options.loadIterations; i++) {
+            s.micros.push_back(timeMicros([&] {
+                packed.forEachVerseText([&](uint32_t, string_view text) { bytes += text.size(); });
+            }));
+        }
+    }
+    {
+        StageResult& s = stage("build_search_index_nbz");
+        for (int i = 0; i < options.loadIterations; i++) {
+            SearchIndex cold;
+            s.micros.push_back(timeMicros([&] { cold.build(packed); }));
+        }
+    }
+
+    summary = "\"books\":" + to_string(bible.bookCount()) + ",\"chapters\":" + to_string(bible.chapterCount())
+        + ",\"verses\":" + to_string(bible.verseCount()) + ",\"text_bytes\":" + to_string(bible.textSize())
+        + ",\"bin_bytes\":" + to_string(bible.fileSize()) + ",\"nbz_bytes\":" + to_string(packed.fileSize());
+    remove(binPath.c_str());
+    remove(nbzPath.c_str());
+    return stages;
+}
+
+static vector<int> parseScales(const string& list) {
+    vector<int> scales;
+    stringstream ss(list);
+    for (string item; getline(ss, item, ',');) {
+        int scale = safeStoi(item);
+        if (scale > 0) scales.push_back(scale);
+    }
+    return scales;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    string outputPath;
+    int generateScale = 0;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--scales" && hasValue) options.scales = parseScales(argv[++i]);
+        else if (arg == "--iterations" && hasValue) options.iterations = max(1, safeStoi(argv[++i]));
+        else if (arg == "--load-iterations" && hasValue) options.loadIterations = max(1, safeStoi(argv[++i]));
+        else if (arg == "--threads" && hasValue) options.threads = max(1, safeStoi(argv[++i]));
+        else if (arg == "--seed" && hasValue) options.seed = max(0, safeStoi(argv[++i]));
+        else if (arg == "--dir" && hasValue) options.dir = argv[++i];
+        else if (arg == "--corpus" && hasValue) options.corpus = argv[++i];
+        else if (arg == "--generate" && hasValue) generateScale = safeStoi(argv[++i]);
+        else if (arg == "-o" && hasValue) outputPath = argv[++i];
+        else {
+            cerr << "Usage: nabreterm_bench [--scales 1,10,100] [--iterations N] [--load-iterations N]\n"
+                 << "                       [--threads N] [--seed N] [--dir DIR] [--corpus FILE] [-o FILE]\n"
+                 << "       nabreterm_bench --generate SCALE [--seed N] [-o FILE]\n";
+            return 1;
+        }
+    }
+
+    if (generateScale != 0) {
+        if (generateScale < 0) return 1;
+        if (outputPath.empty()) outputPath = "bench_corpus_" + to_string(generateScale) + "x.json";
+        return generateCorpus(outputPath, generateScale, options.seed) ? 0 : 1;
+    }
+
+    // Corpora to run: the given file, or one per scale
+    vector<pair<int, string>> corpora;
+    if (!options.corpus.empty()) {
+        corpora.emplace_back(0, options.corpus);
+    } else {
+        for (int scale : options.scales) {
+            string path = options.dir + "/bench_corpus_" + to_string(scale) + "x.json";
+            if (!ifstream(path).is_open()) {
+                cerr << "Generating " << path << "\n";
+                if (!generateCorpus(path, scale, options.seed)) return 1;
+            }
+            corpora.emplace_back(scale, path);
+        }
+    }
+
+    string report = "{\n  \"threads\":" + to_string(options.threads) + ",\"iterations\":" + to_string(options.iterations)
+        + ",\"load_iterations\":" + to_string(options.loadIterations) + ",\"seed\":" + to_string(options.seed)
+        + ",\n  \"runs\":[\n";
+    for (size_t c = 0; c < corpora.size(); c++) {
+        cerr << "Benchmarking " << corpora[c].second << "\n";
+        string summary;
+        vector<StageResult> stages = benchCorpus(corpora[c].second, options, summary);
+        if (stages.empty()) return 1;
+        report += "    {\"scale\":" + to_string(corpora[c].first) + ",\"corpus\":";
+        appendQuoted(report, corpora[c].second);
+        report += "," + summary + ",\"stages\":[\n";
+        for (size_t s = 0; s < stages.size(); s++) {
+            appendStage(report, stages[s]);
+            report += s + 1 < stages.size() ? ",\n" : "\n";
+        }
+        report += c + 1 < corpora.size() ? "    ]},\n" : "    ]}\n";
+    }
+    report += "  ]\n}\n";
+
+    if (outputPath.empty()) {
+        cout << report;
+        return 0;
+    }
+    ofstream file(outputPath);
+    file << report;
+    return file ? 0 : 1;
+}
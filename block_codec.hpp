@@ -0,0 +1,121 @@
+// block_codec.hpp
+// Independent deflate blocks sharing one preset dictionary (nabre.nbz).
+//
+// Each block is a raw deflate stream (no zlib header or checksum: the
+// container records every block's size), so any block inflates on its own.
+// A chapter of verse text is only a few kilobytes, too little for deflate to
+// find much repetition inside it, so every block starts from a dictionary of
+// the corpus's most frequent words: deflate can then refer back to them from
+// the block's first byte. zlib's window caps the dictionary at 32 KB.
+#ifndef NABRETERM_BLOCK_CODEC_HPP
+#define NABRETERM_BLOCK_CODEC_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+constexpr size_t MAX_DICTIONARY = 32768;
+
+// Counts the words of sample text; build() packs the most valuable ones
+class DictionaryTrainer {
+public:
+    // Words are kept with the space that follows them, as they recur
+    void add(std::string_view text) {
+        size_t i = 0;
+        while (i < text.size()) {
+            size_t end = text.find(' ', i);
+            end = end == std::string_view::npos ? text.size() : end + 1;
+            if (end - i >= 3 && end - i <= 32) counts_[std::string(text.substr(i, end - i))]++;
+            i = end;
+        }
+    }
+
+    // Words by bytes they would save (length × repeats), best last: zlib
+    // reaches the end of the dictionary with the shortest distances
+    std::string build(size_t maxSize = MAX_DICTIONARY) const {
+        std::vector<std::pair<uint64_t, const std::string*>> ranked;
+        for (auto& entry : counts_) {
+            if (entry.second > 1) ranked.push_back({ uint64_t(entry.second - 1) * entry.first.size(), &entry.first });
+        }
+        std::sort(ranked.begin(), ranked.end(), [](auto& a, auto& b) {
+            return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+        });
+        std::vector<const std::string*> chosen;
+        size_t size = 0;
+        for (auto& r : ranked) {
+            if (size + r.second->size() > maxSize) continue;
+            chosen.push_back(r.second);
+            size += r.second->size();
+        }
+        std::string dictionary;
+        dictionary.reserve(size);
+        for (size_t i = chosen.size(); i-- > 0;) dictionary += *chosen[i];
+        return dictionary;
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> counts_;
+};
+
+// One deflate state reused for every block
+class BlockDeflater {
+public:
+    explicit BlockDeflater(std::string dictionary = {}) : dictionary_(std::move(dictionary)) {
+        ok_ = deflateInit2(&zs_, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~BlockDeflater() {
+        if (ok_) deflateEnd(&zs_);
+    }
+    BlockDeflater(const BlockDeflater&) = delete;
+    BlockDeflater& operator=(const BlockDeflater&) = delete;
+
+    const std::string& dictionary() const { return dictionary_; }
+
+    // Append in, compressed as one block, to out
+    bool compress(std::string_view in, std::string& out) {
+        if (!ok_ || deflateReset(&zs_) != Z_OK) return false;
+        if (!dictionary_.empty()
+            && deflateSetDictionary(&zs_, reinterpret_cast<const Bytef*>(dictionary_.data()), dictionary_.size()) != Z_OK) {
+            return false;
+        }
+        const size_t start = out.size();
+        out.resize(start + deflateBound(&zs_, in.size()));
+        zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        zs_.avail_in = in.size();
+        zs_.next_out = reinterpret_cast<Bytef*>(&out[start]);
+        zs_.avail_out = out.size() - start;
+        const bool done = deflate(&zs_, Z_FINISH) == Z_STREAM_END;
+        out.resize(start + (done ? zs_.total_out : 0));
+        return done;
+    }
+
+private:
+    z_stream zs_{};
+    std::string dictionary_;
+    bool ok_ = false;
+};
+
+// Inflate one block into out[0, rawSize); false unless it fills it exactly
+inline bool inflateBlock(std::string_view block, std::string_view dictionary, char* out, size_t rawSize) {
+    z_stream zs{};
+    if (inflateInit2(&zs, -15) != Z_OK) return false;
+    bool ok = dictionary.empty()
+              || inflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(dictionary.data()), dictionary.size()) == Z_OK;
+    if (ok) {
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.data()));
+        zs.avail_in = block.size();
+        zs.next_out = reinterpret_cast<Bytef*>(out);
+        zs.avail_out = rawSize;
+        ok = inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out == rawSize;
+    }
+    inflateEnd(&zs);
+    return ok;
+}
+
+#endif // NABRETERM_BLOCK_CODEC_HPP
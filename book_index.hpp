@@ -0,0 +1,108 @@
+// book_index.hpp
+// Sidecar offset table for nabre.json (nabre.json.idx), so that a one-shot
+// reference lookup parses only the book it prints.
+//
+// The table holds each book's name and the byte range of its object in the
+// JSON, under a header with the JSON's size and modification time; once
+// those no longer match the table is ignored. `nabreterm compile` writes it
+// next to the JSON, and so does a lookup that had to parse the whole file.
+// With it, loadCorpusForBook() builds a corpus in which every book has its
+// name but only the requested one has chapters, reading just that book's
+// bytes, so book names still resolve (fuzzily too) exactly as they do
+// against the full corpus. Search and random always load everything.
+#ifndef NABRETERM_BOOK_INDEX_HPP
+#define NABRETERM_BOOK_INDEX_HPP
+
+#include "corpus.hpp"
+#include "reference_index.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//   NABREIDX <version> <json size> <json mtime>
+//   <begin> <end> <book name>        one line per book, in corpus order
+constexpr char BOOK_INDEX_MAGIC[] = "NABREIDX";
+constexpr uint32_t BOOK_INDEX_VERSION = 1;
+
+inline std::string bookIndexPath(const std::string& jsonPath) {
+    return jsonPath + ".idx";
+}
+
+// Write the table for a corpus just loaded from jsonPath with its spans
+inline bool writeBookIndex(const std::string& jsonPath, const Corpus& corpus, const std::vector<JsonSpan>& spans) {
+    JsonStamp stamp;
+    if (spans.size() != corpus.bookCount() || !stampOf(jsonPath, stamp)) return false;
+    std::string table = std::string(BOOK_INDEX_MAGIC) + " " + std::to_string(BOOK_INDEX_VERSION) + " "
+                        + std::to_string(stamp.size) + " " + std::to_string(stamp.mtime) + "\n";
+    for (uint32_t b = 0; b < corpus.bookCount(); b++) {
+        std::string_view name = corpus.bookName(b);
+        if (name.find('\n') != std::string_view::npos) return false;
+        table += std::to_string(spans[b].begin) + " " + std::to_string(spans[b].end) + " ";
+        table.append(name.data(), name.size());
+        table += '\n';
+    }
+    std::ofstream out(bookIndexPath(jsonPath), std::ios::binary | std::ios::trunc);
+    return out.is_open() && out.write(table.data(), table.size());
+}
+
+// The table for jsonPath; false if it is missing, malformed or stale
+inline bool readBookIndex(const std::string& jsonPath, std::vector<std::string>& names, std::vector<JsonSpan>& spans) {
+    names.clear();
+    spans.clear();
+    JsonStamp stamp;
+    std::ifstream file(bookIndexPath(jsonPath), std::ios::binary);
+    if (!file.is_open() || !stampOf(jsonPath, stamp)) return false;
+
+    std::string line, magic;
+    uint32_t version = 0;
+    JsonStamp recorded;
+    if (!std::getline(file, line)) return false;
+    std::istringstream header(line);
+    if (!(header >> magic >> version >> recorded.size >> recorded.mtime) || magic != BOOK_INDEX_MAGIC
+        || version != BOOK_INDEX_VERSION || !(recorded == stamp)) {
+        return false;
+    }
+    while (std::getline(file, line)) {
+        std::istringstream row(line);
+        JsonSpan span;
+        if (!(row >> span.begin >> span.end) || row.get() != ' ' || span.begin > span.end || span.end > stamp.size) {
+            return false;
+        }
+        names.emplace_back(line.substr(row.tellg()));
+        spans.push_back(span);
+    }
+    return !names.empty();
+}
+
+// Load the corpus for a lookup in one book: nabre.bin or nabre.nbz as
+// loadCorpus() does (the one is mapped, so only the pages read are touched;
+// the other inflates only the chapters read), else each nabre.json
+// through its table when that is current, and in full otherwise (writing
+// the table for the next lookup). A book that does not resolve leaves the
+// corpus with names only, which is all "Book not found." needs.
+inline bool loadCorpusForBook(Corpus& corpus, const std::string& book) {
+    if (loadCompiledCorpus(corpus)) return true;
+    const std::string dataDir = NABRETERM_DATADIR;
+    for (const std::string& path : { std::string("nabre.json"), dataDir + "/nabre.json" }) {
+        std::vector<std::string> names;
+        std::vector<JsonSpan> spans;
+        if (readBookIndex(path, names, spans) && corpus.loadJsonBook(path, names, ReferenceIndex::NO_BOOK, {})) {
+            ReferenceIndex refs;
+            refs.build(corpus);
+            const uint32_t b = refs.resolveBook(corpus, book);
+            if (b == ReferenceIndex::NO_BOOK || corpus.loadJsonBook(path, names, b, spans[b])) return true;
+        }
+        if (corpus.loadJson(path, &spans)) {
+            writeBookIndex(path, corpus, spans);
+            return true;
+        }
+    }
+    std::cerr << "Could not open NABRE JSON file.\n";
+    return false;
+}
+
+#endif // NABRETERM_BOOK_INDEX_HPP
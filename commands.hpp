@@ -0,0 +1,358 @@
+// commands.hpp
+// nabreterm's reference, search and random commands: everything between a
+// parsed command line and the OutputWriter, shared by main.cpp and the
+// end-to-end benchmark.
+#ifndef NABRETERM_COMMANDS_HPP
+#define NABRETERM_COMMANDS_HPP
+
+#include "corpus.hpp"
+#include "highlighter.hpp"
+#include "output.hpp"
+#include "query_plan.hpp"
+#include "reference_index.hpp"
+#include "search_index.hpp"
+#include "stats.hpp"
+#include "text_fold.hpp"
+#include "thread_pool.hpp"
+#include "verse_sampler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Utility: lowercase conversion
+inline std::string toLower(const std::string& s) {
+    std::string result = s;
+    std::transform(result.begin(), result.end(), result.begin(),
+              [](unsigned char c){ return std::tolower(c); });
+    return result;
+}
+
+// --- Safe stoi wrapper ---
+inline int safeStoi(const std::string& s, std::ostream& err = std::cerr) {
+    try {
+        return std::stoi(s);
+    } catch (...) {
+        err << "Invalid number: " << s << "\n";
+        return -1; // sentinel value
+    }
+}
+
+inline bool isNewTestament(const std::string& book) {
+    static std::vector<std::string> ntBooks = {
+        "Matthew","Mark","Luke","John","Acts","Romans",
+        "1Corinthians","2Corinthians","Galatians","Ephesians","Philippians",
+        "Colossians","1Thessalonians","2Thessalonians","1Timothy","2Timothy",
+        "Titus","Philemon","Hebrews","James","1Peter","2Peter",
+        "1John","2John","3John","Jude","Revelation"
+    };
+    return std::find(ntBooks.begin(), ntBooks.end(), book) != ntBooks.end();
+}
+
+inline bool isDeuterocanonical(const std::string& book) {
+    static std::vector<std::string> deutBooks = {
+        "Tobit","Judith","Wisdom","Sirach","Baruch","1Maccabees","2Maccabees"
+    };
+    return std::find(deutBooks.begin(), deutBooks.end(), book) != deutBooks.end();
+}
+
+// -- Unified Search Engine --
+inline void searchEngine(const Corpus& bible, SearchIndex& index, ThreadPool& pool, const SearchOptions& options,
+                         OutputWriter& out, const std::string& query, const std::string& scopeBook = "") {
+    // Compile once: tokenize → postfix → register program
+    QueryPlan plan = QueryPlan::compile(query, options);
+    if (!plan.error().empty()) {
+        out.err() << plan.error() << "\n";
+        return;
+    }
+
+    // Evaluate the plan on the inverted index (built on first search)
+    if (!index.built()) index.build(bible);
+    // Only highlight if NOT operator is not used (and never without color).
+    // Keywords are highlighted by the query's Highlighter, phrases and NEAR
+    // by the word positions that matched.
+    bool highlight = plan.highlight() && out.color();
+    bool positional = plan.positional();
+    std::vector<uint32_t> matchedWords;
+    std::vector<FuzzyExpansion> expansions;
+    std::vector<VerseSet> termHits;
+    VerseSet matches = index.evaluate(plan, &expansions, &pool, highlight && positional ? &matchedWords : nullptr,
+                                      options.ranked ? &termHits : nullptr);
+
+    Highlighter highlighter;
+    if (highlight) highlighter = Highlighter::forQuery(plan);
+
+    // Walk the matches in canonical order, keeping those in scope
+    struct Hit { uint32_t verse, book, chapter; };
+    std::vector<Hit> hits;
+    auto next = matches.begin();
+    const std::string scope = toLower(scopeBook);
+    for (uint32_t bi = 0; bi < bible.bookCount(); bi++) {
+        if (!scope.empty() && toLower(std::string(bible.bookName(bi))) != scope) continue;
+        const BookRecord& b = bible.book(bi);
+
+        for (uint32_t ci = b.firstChapter; ci < b.firstChapter + b.chapterCount; ci++) {
+            const ChapterRecord& ch = bible.chapter(ci);
+            next = std::lower_bound(next, matches.end(), ch.firstVerse);
+            for (; next != matches.end() && *next < ch.firstVerse + ch.verseCount; ++next) {
+                hits.push_back({ *next, bi, ch.number });
+            }
+        }
+    }
+    bool found = !hits.empty();
+    size_t total = hits.size();
+
+    // One page of them: the best offset + limit by BM25 when ranked (kept
+    // in a bounded heap), else a slice in canonical order
+    if (options.ranked) {
+        std::vector<uint32_t> verses;
+        for (auto& h : hits) verses.push_back(h.verse);
+        size_t k = options.limit ? options.offset + options.limit : total;
+        std::vector<size_t> order = index.rank(plan, verses, termHits, k);
+        std::vector<Hit> page;
+        for (size_t i = options.offset; i < order.size(); i++) page.push_back(hits[order[i]]);
+        hits.swap(page);
+    } else if (options.offset || options.limit) {
+        size_t first = std::min(options.offset, total);
+        size_t last = options.limit ? std::min(total, first + options.limit) : total;
+        hits = std::vector<Hit>(hits.begin() + first, hits.begin() + last);
+    }
+
+    // Highlight and format in parallel, one buffer per chunk, printed in
+    // order. Keywords are found in the folded verse in one pass and mapped
+    // back onto the original text, which is appended with its highlights.
+    ScopedTimer formatTimer(StatPhase::Output);
+    addStat(StatCounter::VersesPrinted, hits.size());
+    size_t grain = pool.grainFor(hits.size());
+    std::vector<std::string> chunks((hits.size() + grain - 1) / grain);
+    pool.parallelFor(hits.size(), grain, [&](size_t first, size_t last, size_t chunk) {
+        std::string& buf = chunks[chunk];
+        FoldBuffer foldBuffer;
+        std::vector<ByteRange> ranges;
+        for (size_t h = first; h < last; h++) {
+            uint32_t vi = hits[h].verse;
+            if (out.structured()) {
+                appendRecord(buf, out.format(),
+                             { bible.bookName(hits[h].book), hits[h].chapter, bible.verse(vi).number, bible.verseText(vi) });
+                continue;
+            }
+            ranges.clear();
+            if (highlight && positional) ranges = index.positionRanges(vi, matchedWords);
+            if (!highlighter.empty()) highlighter.find(index.foldedVerse(vi, foldBuffer), ranges);
+            mergeRanges(ranges);
+
+            buf += out.ansi("\033[1;34m");
+            appendQuoted(buf, bible.bookName(hits[h].book));
+            buf += " " + std::string(out.ansi("\033[32m")) + std::to_string(hits[h].chapter) + ":"
+            + std::to_string(bible.verse(vi).number) + out.ansi("\033[0m") + " → ";
+            appendHighlighted(buf, bible.verseText(vi), ranges, "\033[1;31m", "\033[0m");
+            buf += "\n";
+        }
+    });
+    for (auto& chunk : chunks) out.append(chunk);
+    formatTimer.stop();
+    out.flush();
+
+    // Report how many vocabulary words each keyword's fuzzy fallback used
+    std::string report;
+    for (auto& e : expansions) {
+        if (e.terms == 0) continue;
+        report += (report.empty() ? "" : ", ") + e.keyword + " → " + std::to_string(e.terms)
+        + (e.terms == 1 ? " word" : " words");
+    }
+    if (!report.empty()) {
+        out.err() << "Fuzzy (≤" << options.fuzzyDistance << " edits): " << report << "\n";
+    }
+
+    if (!found) {
+        out.err() << "Error: No matches found.\n";
+    } else if (hits.empty()) {
+        out.err() << "No more matches (" << total << " in all).\n";
+    } else if (options.offset || options.limit) {
+        out.err() << "Matches " << options.offset + 1 << "-" << options.offset + hits.size() << " of " << total << "\n";
+    }
+}
+
+// Helper: resolve book name with fuzzy matching
+inline std::string resolveBook(const Corpus& bible, const ReferenceIndex& refs, const std::string& input) {
+    uint32_t bi = refs.resolveBook(bible, input); // fuzzy match threshold: 2 edits
+    if (bi != ReferenceIndex::NO_BOOK) return std::string(bible.bookName(bi));
+    return input; // fallback if no match
+}
+
+
+// --- Whole chapter helper ---
+inline void runChapter(const Corpus& bible, const ReferenceIndex& refs, OutputWriter& out, const std::string& book,
+                       int chapter) {
+    ScopedTimer timer(StatPhase::Reference);
+    // Step 1: find closest book (exact name first, then fuzzy)
+    uint32_t bestIndex = refs.resolveBook(bible, book);
+
+    // Step 2: check threshold
+    if (bestIndex == ReferenceIndex::NO_BOOK) {
+        out.err() << "Book not found.\n";
+        return;
+    }
+    std::string bestBook(bible.bookName(bestIndex));
+
+    // Step 3: suggest if fuzzy
+    if (toLower(bestBook) != toLower(book)) {
+        out.err() << "Did you mean '" << bestBook << "'?\n";
+    }
+
+    // Step 4: the chapter's verses are one contiguous range
+    VerseRange range = refs.chapter(bestIndex, chapter);
+    addStat(StatCounter::VersesPrinted, range.last - range.first);
+    for (uint32_t vi = range.first; vi < range.last; vi++) {
+        if (out.structured()) {
+            out.record({ bestBook, uint32_t(chapter), refs.verseNumber(vi), bible.verseText(vi) });
+            continue;
+        }
+        std::string& buf = out.buffer();
+        buf += out.ansi("\033[1;34m") + bestBook + out.ansi("\033[0m") + out.ansi("\033[32m") + std::to_string(chapter)
+        + ":" + std::to_string(refs.verseNumber(vi)) + out.ansi("\033[0m") + " → ";
+        appendQuoted(buf, bible.verseText(vi));
+        buf += "\n";
+        out.commit();
+    }
+    out.flush();
+    if (range.empty()) out.err() << "Chapter not found.\n";
+}
+
+inline void runRange(const Corpus& bible, const ReferenceIndex& refs, OutputWriter& out, const std::string& book,
+                     int chapter, const std::string& verseArg) {
+    ScopedTimer timer(StatPhase::Reference);
+    // Step 1: find closest book (exact name first, then fuzzy)
+    uint32_t bestIndex = refs.resolveBook(bible, book);
+
+    // Step 2: check threshold
+    if (bestIndex == ReferenceIndex::NO_BOOK) {
+        out.err() << "Book not found.\n";
+        return;
+    }
+    std::string bestBook(bible.bookName(bestIndex));
+
+    // Step 3: suggest if fuzzy
+    if (toLower(bestBook) != toLower(book)) {
+        out.err() << "Did you mean '" << bestBook << "'?\n";
+    }
+
+    // Step 4: parse verse range
+    int startVerse, endVerse;
+    if (verseArg.find('-') != std::string::npos) {
+        std::stringstream ss(verseArg);
+        std::string start, end;
+        std::getline(ss, start, '-');
+        std::getline(ss, end, '-');
+        startVerse = safeStoi(start, out.err());
+        endVerse   = safeStoi(end, out.err());
+        if (startVerse == -1 || endVerse == -1) return; // invalid input
+
+    } else {
+        startVerse = endVerse = safeStoi(verseArg, out.err());
+        if (startVerse == -1) return; // invalid input
+
+    }
+
+    // Step 5: look up the verse range inside bestBook
+    size_t printed = 0;
+    VerseRange range = refs.verses(bestIndex, chapter, startVerse, endVerse);
+    for (uint32_t vi = range.first; vi < range.last; vi++) {
+        int verseNum = refs.verseNumber(vi);
+
+        if (verseNum >= startVerse && verseNum <= endVerse) {
+            if (out.structured()) {
+                out.record({ bestBook, uint32_t(chapter), uint32_t(verseNum), bible.verseText(vi) });
+            } else {
+                std::string& buf = out.buffer();
+                buf += out.ansi("\033[1;34m") + bestBook + " " + out.ansi("\033[32m") + std::to_string(chapter) + ":"
+                + std::to_string(verseNum) + out.ansi("\033[0m") + " → ";
+                appendQuoted(buf, bible.verseText(vi));
+                buf += "\n";
+                out.commit();
+            }
+            printed++;
+        }
+    }
+    addStat(StatCounter::VersesPrinted, printed);
+    out.flush();
+
+    if (printed == 0) out.err() << "Verse(s) not found.\n";
+}
+
+// The sampler's named scopes for `random`
+inline void addRandomScopes(const Corpus& bible, VerseSampler& sampler) {
+    sampler.addScope("ot", [&](uint32_t bi) { return !isNewTestament(std::string(bible.bookName(bi))); });
+    sampler.addScope("nt", [&](uint32_t bi) { return isNewTestament(std::string(bible.bookName(bi))); });
+    sampler.addScope("deut", [&](uint32_t bi) { return isDeuterocanonical(std::string(bible.bookName(bi))); });
+}
+
+// random [N] [OT|NT|Deut|Book]: N distinct verses from one random chapter,
+// the chapter being that of a verse drawn uniformly from the scope
+inline void runRandom(const Corpus& bible, const ReferenceIndex& refs, VerseSampler& sampler, OutputWriter& out,
+                      const std::vector<std::string>& tokens) {
+    int verseCount = 1; // default
+    std::string scopeArg;
+
+    // detect if second token is a number
+    if (tokens.size() >= 2) {
+        if (std::isdigit(tokens[1][0])) {
+            verseCount = safeStoi(tokens[1], out.err());
+            if (tokens.size() >= 3) scopeArg = toLower(tokens[2]);
+        } else {
+            scopeArg = toLower(tokens[1]);
+        }
+    }
+
+    if (verseCount <= 0) {
+        out.err() << "Invalid verse count.\n";
+        return;
+    }
+
+    // whole Bible by default, then OT/NT/Deut, then a fuzzy-matched book
+    uint32_t first = VerseSampler::NO_VERSE;
+    if (sampler.hasScope(scopeArg)) {
+        first = sampler.pick(scopeArg);
+    } else {
+        uint32_t bi = refs.resolveBook(bible, scopeArg);
+        if (bi != ReferenceIndex::NO_BOOK) first = sampler.pickInBook(bi);
+    }
+
+    if (first == VerseSampler::NO_VERSE) {
+        out.err() << "Scope not found.\n";
+        return;
+    }
+
+    uint32_t ci = bible.chapterOf(first);
+    uint32_t bi = bible.bookOf(ci);
+    const ChapterRecord& ch = bible.chapter(ci);
+
+    if (ch.verseCount < static_cast<size_t>(verseCount)) {
+        out.err() << "Not enough verses in this chapter.\n";
+        return;
+    }
+
+    // pick distinct verses (the chapter was drawn in proportion to its
+    // length, so even one verse is uniform over the scope)
+    for (uint32_t vi : sampler.pickInChapter(ci, verseCount)) {
+        if (out.structured()) {
+            out.record({ bible.bookName(bi), ch.number, bible.verse(vi).number, bible.verseText(vi) });
+            continue;
+        }
+        std::string& buf = out.buffer();
+        buf += out.ansi("\033[1;34m");
+        appendQuoted(buf, bible.bookName(bi));
+        buf += " " + std::string(out.ansi("\033[32m")) + std::to_string(ch.number) + ":"
+        + std::to_string(bible.verse(vi).number) + out.ansi("\033[0m") + " → ";
+        appendQuoted(buf, bible.verseText(vi));
+        buf += "\n";
+        out.commit();
+    }
+    out.flush();
+}
+
+#endif // NABRETERM_COMMANDS_HPP
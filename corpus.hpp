@@ -0,0 +1,853 @@
+// corpus.hpp
+// Flat, read-only view of the NABRE text shared by nabreterm and nabretermui.
+//
+// The corpus is stored as four tables: books, chapters, verses and one UTF-8
+// text blob. `nabreterm compile` writes those tables verbatim to nabre.bin so
+// that later runs can mmap the file and answer queries without parsing JSON.
+// `nabreterm compile -o nabre.nbz` writes a compressed corpus instead, in
+// which each chapter's text is its own deflate block: only the chapters a
+// command reads are inflated, and a full pass (building the search index,
+// a text scan) streams them one at a time. When neither file is present the
+// tables are built from nabre.json. A compiled corpus records the size and
+// modification time of the JSON it came from, and is passed over (with a
+// warning) once the nabre.json beside it no longer matches them.
+#ifndef NABRETERM_CORPUS_HPP
+#define NABRETERM_CORPUS_HPP
+
+#ifndef NABRETERM_DATADIR
+#define NABRETERM_DATADIR "."
+#endif
+
+#include "block_codec.hpp"
+#include "json_reader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --- Binary layout (native little-endian, sections 8-byte aligned) ---
+//   CorpusHeader
+//   BookRecord[bookCount]
+//   ChapterRecord[chapterCount]
+//   VerseRecord[verseCount]
+//   char text[textSize]      book names followed by verse texts
+constexpr char CORPUS_MAGIC[8] = {'N', 'A', 'B', 'R', 'E', 'B', 'I', 'N'};
+constexpr uint32_t CORPUS_VERSION = 2;
+
+struct CorpusHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bookCount;
+    uint32_t chapterCount;
+    uint32_t verseCount;
+    uint64_t textSize;
+    uint64_t bookOffset;
+    uint64_t chapterOffset;
+    uint64_t verseOffset;
+    uint64_t textOffset;
+    uint64_t sourceSize;      // JsonStamp of the nabre.json compiled
+    int64_t sourceMtime;
+};
+
+struct BookRecord {
+    uint32_t nameOffset;     // into text blob
+    uint32_t nameLength;
+    uint32_t firstChapter;   // index into chapter table
+    uint32_t chapterCount;
+};
+
+struct ChapterRecord {
+    uint32_t number;
+    uint32_t firstVerse;     // index into verse table
+    uint32_t verseCount;
+};
+
+struct VerseRecord {
+    uint32_t number;
+    uint32_t textOffset;     // into text blob
+    uint32_t textLength;
+};
+
+// --- Compressed layout (nabre.nbz, native little-endian) ---
+//   BlockCorpusHeader
+//   char dictionary[dictionarySize]                    see block_codec.hpp
+//   deflate(BookRecord[] ChapterRecord[] VerseRecord[] ChapterBlock[] names)
+//   one deflate block per chapter: its verse texts, back to back
+// Verse textOffsets are relative to their chapter's block, and book
+// nameOffsets to the names.
+constexpr char BLOCK_CORPUS_MAGIC[8] = {'N', 'A', 'B', 'R', 'E', 'B', 'L', 'Z'};
+constexpr uint32_t BLOCK_CORPUS_VERSION = 2;
+
+struct BlockCorpusHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bookCount;
+    uint32_t chapterCount;
+    uint32_t verseCount;
+    uint32_t dictionarySize;
+    uint32_t namesSize;
+    uint64_t dictionaryOffset;
+    uint64_t tableOffset;
+    uint64_t tableSize;       // compressed
+    uint64_t blockOffset;     // ChapterBlock offsets count from here
+    uint64_t sourceSize;      // JsonStamp of the nabre.json compiled
+    int64_t sourceMtime;
+};
+
+struct ChapterBlock {
+    uint64_t offset;
+    uint32_t size;            // compressed
+    uint32_t rawSize;
+};
+
+// Size and modification time of a nabre.json, kept by the files derived
+// from it (compiled corpora, the book index) to notice when it changes;
+// all zero when unknown
+struct JsonStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    bool operator==(const JsonStamp& o) const { return size == o.size && mtime == o.mtime; }
+    bool known() const { return size != 0 || mtime != 0; }
+};
+
+inline bool stampOf(const std::string& path, JsonStamp& stamp) {
+    std::error_code ec;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    stamp.mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+// Byte range [begin, end) of one book's object in nabre.json
+struct JsonSpan {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+};
+
+class Corpus {
+public:
+    Corpus() = default;
+    Corpus(const Corpus&) = delete;
+    Corpus& operator=(const Corpus&) = delete;
+    ~Corpus() { unmap(); }
+
+    uint32_t bookCount() const { return bookCount_; }
+    uint32_t chapterCount() const { return chapterCount_; }
+    uint32_t verseCount() const { return verseCount_; }
+
+    const BookRecord& book(uint32_t b) const { return books_[b]; }
+    const ChapterRecord& chapter(uint32_t c) const { return chapters_[c]; }
+    const VerseRecord& verse(uint32_t v) const { return verses_[v]; }
+
+    std::string_view bookName(uint32_t b) const {
+        return { text_ + books_[b].nameOffset, books_[b].nameLength };
+    }
+    std::string_view verseText(uint32_t v) const {
+        if (!blocks_.empty()) return { chapterText(chapterOf(v)) + verses_[v].textOffset, verses_[v].textLength };
+        return { text_ + verses_[v].textOffset, verses_[v].textLength };
+    }
+
+    // Loaded from nabre.nbz: verse text is inflated a chapter at a time
+    bool compressed() const { return !blocks_.empty(); }
+
+    // fn(v, text) for every verse, or for the sorted IDs in only, in order.
+    // A compressed corpus inflates each chapter into one scratch buffer
+    // instead of keeping it, unless it is already resident, so a full pass
+    // never holds the whole text. An fn that returns bool stops the pass
+    // by returning false.
+    template <class Fn>
+    void forEachVerseText(Fn fn, const std::vector<uint32_t>* only = nullptr) const {
+        auto call = [&fn](uint32_t v, std::string_view text) {
+            if constexpr (std::is_same_v<std::invoke_result_t<Fn&, uint32_t, std::string_view>, bool>) {
+                return fn(v, text);
+            } else {
+                fn(v, text);
+                return true;
+            }
+        };
+        const uint32_t count = only ? only->size() : verseCount_;
+        if (blocks_.empty()) {
+            for (uint32_t i = 0; i < count; i++) {
+                const uint32_t v = only ? (*only)[i] : i;
+                if (!call(v, verseText(v))) return;
+            }
+            return;
+        }
+        std::string scratch;
+        const char* text = nullptr;
+        uint32_t c = 0, end = 0;   // chapter in scratch, and its verses' end
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t v = only ? (*only)[i] : i;
+            if (!text || v >= end || v < chapters_[c].firstVerse) {
+                c = chapterOf(v);
+                end = chapters_[c].firstVerse + chapters_[c].verseCount;
+                text = blockReady_[c].load(std::memory_order_acquire) ? chapterText_[c].data()
+                                                                      : inflateChapter(c, scratch);
+            }
+            if (!call(v, std::string_view(text + verses_[v].textOffset, verses_[v].textLength))) return;
+        }
+    }
+
+    // Chapter holding verse v, and book holding chapter c (binary searches
+    // over the firstVerse / firstChapter columns)
+    uint32_t chapterOf(uint32_t v) const {
+        uint32_t lo = 0, hi = chapterCount_;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (chapters_[mid].firstVerse <= v) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+    uint32_t bookOf(uint32_t c) const {
+        uint32_t lo = 0, hi = bookCount_;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (books_[mid].firstChapter <= c) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+
+    // Build the tables from nabre.json in one pass of a pull parser: verse
+    // text is decoded straight into the text arena and numbers into the
+    // record arrays, with no DOM in between. Keys may come in any order;
+    // unknown keys are skipped. spans, if given, receives each book's byte
+    // range in the file (for the sidecar index, see book_index.hpp).
+    bool loadJson(const std::string& path, std::vector<JsonSpan>* spans = nullptr) {
+        std::string data;
+        if (!readFile(path, data)) return false;
+
+        reset();
+        ownText_.reserve(data.size());   // the text can only shrink when unescaped
+        if (spans) spans->clear();
+
+        JsonReader in(data);
+        std::string key;
+        std::string missing;
+        if (in.beginArray()) {
+            while (missing.empty() && in.nextElement()) {
+                const uint64_t begin = in.offset();
+                if (!in.beginObject()) break;
+                ownBooks_.push_back({ 0, 0, (uint32_t)ownChapters_.size(), 0 });
+                bool named = false;
+                while (in.nextKey(key)) {
+                    if (key == "book") {
+                        ownBooks_.back().nameOffset = ownText_.size();
+                        if (!in.readString(ownText_)) break;
+                        ownBooks_.back().nameLength = ownText_.size() - ownBooks_.back().nameOffset;
+                        named = true;
+                    } else if (key == "chapters") {
+                        if (!readChapters(in, missing)) break;
+                    } else if (!in.skipValue()) {
+                        break;
+                    }
+                }
+                if (!named && !in.failed() && missing.empty()) missing = "book name";
+                if (spans) spans->push_back({ begin, in.offset() });
+            }
+        }
+        if (!missing.empty() || !in.finish()) {
+            std::cerr << "Invalid NABRE JSON file: " << (missing.empty() ? in.error() : "missing " + missing) << "\n";
+            reset();
+            if (spans) spans->clear();
+            return false;
+        }
+        adopt();
+        return true;
+    }
+
+    // Every book of names, but with chapters and verses only for book
+    // wanted, parsed from its span of the JSON file; when wanted is out of
+    // range nothing is read. False (and an empty corpus) if the span does
+    // not hold that book.
+    bool loadJsonBook(const std::string& path, const std::vector<std::string>& names, uint32_t wanted,
+                      JsonSpan span) {
+        reset();
+        std::string data;
+        if (wanted < names.size()) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open() || span.end < span.begin) return false;
+            data.resize(span.end - span.begin);
+            if (!file.seekg(span.begin) || !file.read(&data[0], data.size())) return false;
+        }
+
+        for (uint32_t b = 0; b < names.size(); b++) {
+            ownBooks_.push_back({ (uint32_t)ownText_.size(), (uint32_t)names[b].size(), (uint32_t)ownChapters_.size(), 0 });
+            ownText_ += names[b];
+            if (b != wanted) continue;
+
+            JsonReader in(data);
+            std::string key, name, missing;
+            bool chapters = true;
+            if (in.beginObject()) {
+                while (chapters && in.nextKey(key)) {
+                    if (key == "book") chapters = in.readString(name);
+                    else if (key == "chapters") chapters = readChapters(in, missing);
+                    else chapters = in.skipValue();
+                }
+            }
+            if (!chapters || !in.finish() || name != names[b]) {
+                reset();
+                return false;
+            }
+        }
+        adopt();
+        return true;
+    }
+
+    // Bytes held by the tables (mapped or owned), by table; for a
+    // compressed corpus the text is the book names and inflated chapters
+    struct Footprint {
+        uint64_t books, chapters, verses, text;
+        uint64_t total() const { return books + chapters + verses + text; }
+    };
+    Footprint footprint() const {
+        const uint64_t text = blocks_.empty() ? textSize() : ownText_.size() + residentText_.load();
+        return { (uint64_t)bookCount_ * sizeof(BookRecord), (uint64_t)chapterCount_ * sizeof(ChapterRecord),
+                 (uint64_t)verseCount_ * sizeof(VerseRecord), text };
+    }
+    bool mapped() const { return map_ != nullptr; }
+
+    // Size of the file the corpus was mapped from (0 for nabre.json)
+    size_t fileSize() const { return mapSize_; }
+
+    // Stamp of the nabre.json a compiled corpus was made from
+    const JsonStamp& source() const { return source_; }
+
+    // Chapters of a compressed corpus inflated so far
+    uint32_t residentChapters() const {
+        uint32_t n = 0;
+        for (uint32_t c = 0; c < blocks_.size(); c++) n += blockReady_[c].load();
+        return n;
+    }
+
+    // Map a file written by writeBinary(); tables are used in place
+    bool loadBinary(const std::string& path) {
+        reset();
+        const char* base = mapFile(path, sizeof(CorpusHeader));
+        if (!base) return false;
+
+        CorpusHeader h;
+        std::memcpy(&h, base, sizeof h);
+        auto fits = [&](uint64_t offset, uint64_t bytes) {
+            return offset <= mapSize_ && bytes <= mapSize_ - offset;
+        };
+        // Records are read in place, so their sections must be aligned too
+        if (std::memcmp(h.magic, CORPUS_MAGIC, sizeof h.magic) != 0 ||
+            h.version != CORPUS_VERSION ||
+            (h.bookOffset | h.chapterOffset | h.verseOffset) % alignof(uint32_t) != 0 ||
+            !fits(h.bookOffset, (uint64_t)h.bookCount * sizeof(BookRecord)) ||
+            !fits(h.chapterOffset, (uint64_t)h.chapterCount * sizeof(ChapterRecord)) ||
+            !fits(h.verseOffset, (uint64_t)h.verseCount * sizeof(VerseRecord)) ||
+            !fits(h.textOffset, h.textSize)) {
+            std::cerr << "Unsupported or corrupt corpus file: " << path << "\n";
+            unmap();
+            return false;
+        }
+
+        books_ = reinterpret_cast<const BookRecord*>(base + h.bookOffset);
+        chapters_ = reinterpret_cast<const ChapterRecord*>(base + h.chapterOffset);
+        verses_ = reinterpret_cast<const VerseRecord*>(base + h.verseOffset);
+        text_ = base + h.textOffset;
+        bookCount_ = h.bookCount;
+        chapterCount_ = h.chapterCount;
+        verseCount_ = h.verseCount;
+        if (!validTables(h.textSize, h.textSize)) {
+            std::cerr << "Unsupported or corrupt corpus file: " << path << "\n";
+            unmap();
+            return false;
+        }
+        source_ = { h.sourceSize, h.sourceMtime };
+        return true;
+    }
+
+    // Map a file written by writeCompressed(): the tables are inflated,
+    // the chapters' text only when first read
+    bool loadCompressed(const std::string& path) {
+        reset();
+        const char* base = mapFile(path, sizeof(BlockCorpusHeader));
+        if (!base) return false;
+
+        BlockCorpusHeader h;
+        std::memcpy(&h, base, sizeof h);
+        auto fits = [&](uint64_t offset, uint64_t bytes) {
+            return offset <= mapSize_ && bytes <= mapSize_ - offset;
+        };
+        const uint64_t tableRaw = (uint64_t)h.bookCount * sizeof(BookRecord)
+                                  + (uint64_t)h.chapterCount * (sizeof(ChapterRecord) + sizeof(ChapterBlock))
+                                  + (uint64_t)h.verseCount * sizeof(VerseRecord) + h.namesSize;
+        std::string table;
+        bool ok = std::memcmp(h.magic, BLOCK_CORPUS_MAGIC, sizeof h.magic) == 0 && h.version == BLOCK_CORPUS_VERSION
+                  && h.dictionarySize <= MAX_DICTIONARY && fits(h.dictionaryOffset, h.dictionarySize)
+                  && fits(h.tableOffset, h.tableSize) && h.blockOffset <= mapSize_
+                  && tableRaw <= h.tableSize * 1032 + 64;   // deflate's best ratio
+        if (ok) {
+            table.resize(tableRaw);
+            ok = inflateBlock({ base + h.tableOffset, h.tableSize }, {}, &table[0], table.size());
+        }
+        if (ok) {
+            const char* p = table.data();
+            auto take = [&](auto& column, uint32_t count) {
+                using Record = typename std::decay_t<decltype(column)>::value_type;
+                column.resize(count);
+                std::memcpy(column.data(), p, count * sizeof(Record));
+                p += count * sizeof(Record);
+            };
+            take(ownBooks_, h.bookCount);
+            take(ownChapters_, h.chapterCount);
+            take(ownVerses_, h.verseCount);
+            take(blocks_, h.chapterCount);
+            ownText_.assign(p, h.namesSize);
+            adopt();
+            ok = validTables(h.namesSize, 0) && validBlocks(mapSize_ - h.blockOffset);
+        }
+        if (!ok) {
+            std::cerr << "Unsupported or corrupt corpus file: " << path << "\n";
+            reset();
+            return false;
+        }
+
+        for (ChapterBlock& block : blocks_) block.offset += h.blockOffset;
+        dictionary_ = { base + h.dictionaryOffset, h.dictionarySize };
+        chapterText_.resize(blocks_.size());
+        blockReady_.reset(new std::atomic<bool>[blocks_.size()]());
+        source_ = { h.sourceSize, h.sourceMtime };
+        return true;
+    }
+
+    // Write the corpus as nabre.nbz: a dictionary trained on the verse
+    // text, the tables, and one block per chapter. source is the stamp of
+    // the JSON it was loaded from.
+    bool writeCompressed(const std::string& path, const JsonStamp& source = {}) const {
+        if (!blocks_.empty()) return false;
+        DictionaryTrainer trainer;
+        for (uint32_t v = 0; v < verseCount_; v++) trainer.add(verseText(v));
+        BlockDeflater deflater(trainer.build());
+
+        std::vector<BookRecord> books(books_, books_ + bookCount_);
+        std::vector<VerseRecord> verses(verses_, verses_ + verseCount_);
+        std::vector<ChapterBlock> blocks(chapterCount_);
+        std::string names, data, raw;
+        for (BookRecord& b : books) {
+            const uint32_t offset = names.size();
+            names.append(text_ + b.nameOffset, b.nameLength);
+            b.nameOffset = offset;
+        }
+        for (uint32_t c = 0; c < chapterCount_; c++) {
+            raw.clear();
+            for (uint32_t v = chapters_[c].firstVerse; v < chapters_[c].firstVerse + chapters_[c].verseCount; v++) {
+                verses[v].textOffset = raw.size();
+                raw.append(text_ + verses_[v].textOffset, verses_[v].textLength);
+            }
+            blocks[c] = { data.size(), 0, (uint32_t)raw.size() };
+            if (!deflater.compress(raw, data)) return false;
+            blocks[c].size = data.size() - blocks[c].offset;
+        }
+
+        std::string table;
+        auto put = [&](const auto* records, size_t count) {
+            table.append(reinterpret_cast<const char*>(records), count * sizeof(*records));
+        };
+        put(books.data(), books.size());
+        put(chapters_, chapterCount_);
+        put(verses.data(), verses.size());
+        put(blocks.data(), blocks.size());
+        table += names;
+        std::string packed;
+        if (!BlockDeflater().compress(table, packed)) return false;
+
+        BlockCorpusHeader h{};
+        std::memcpy(h.magic, BLOCK_CORPUS_MAGIC, sizeof h.magic);
+        h.version = BLOCK_CORPUS_VERSION;
+        h.bookCount = bookCount_;
+        h.chapterCount = chapterCount_;
+        h.verseCount = verseCount_;
+        h.dictionarySize = deflater.dictionary().size();
+        h.namesSize = names.size();
+        h.dictionaryOffset = sizeof h;
+        h.tableOffset = h.dictionaryOffset + h.dictionarySize;
+        h.tableSize = packed.size();
+        h.blockOffset = h.tableOffset + h.tableSize;
+        h.sourceSize = source.size;
+        h.sourceMtime = source.mtime;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char*>(&h), sizeof h);
+        out.write(deflater.dictionary().data(), h.dictionarySize);
+        out.write(packed.data(), packed.size());
+        out.write(data.data(), data.size());
+        return (bool)out;
+    }
+
+    bool writeBinary(const std::string& path, const JsonStamp& source = {}) const {
+        if (!blocks_.empty()) return false;   // offsets are per chapter; load the JSON
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        auto align8 = [](uint64_t n) { return (n + 7) & ~uint64_t(7); };
+        CorpusHeader h{};
+        std::memcpy(h.magic, CORPUS_MAGIC, sizeof h.magic);
+        h.version = CORPUS_VERSION;
+        h.bookCount = bookCount_;
+        h.chapterCount = chapterCount_;
+        h.verseCount = verseCount_;
+        h.textSize = textSize();
+        h.bookOffset = align8(sizeof h);
+        h.chapterOffset = align8(h.bookOffset + (uint64_t)bookCount_ * sizeof(BookRecord));
+        h.verseOffset = align8(h.chapterOffset + (uint64_t)chapterCount_ * sizeof(ChapterRecord));
+        h.textOffset = align8(h.verseOffset + (uint64_t)verseCount_ * sizeof(VerseRecord));
+        h.sourceSize = source.size;
+        h.sourceMtime = source.mtime;
+
+        auto section = [&](uint64_t offset, const void* data, size_t bytes) {
+            static const char zeros[8] = {};
+            out.write(zeros, offset - (uint64_t)out.tellp());
+            out.write(static_cast<const char*>(data), bytes);
+        };
+        out.write(reinterpret_cast<const char*>(&h), sizeof h);
+        section(h.bookOffset, books_, bookCount_ * sizeof(BookRecord));
+        section(h.chapterOffset, chapters_, chapterCount_ * sizeof(ChapterRecord));
+        section(h.verseOffset, verses_, verseCount_ * sizeof(VerseRecord));
+        section(h.textOffset, text_, h.textSize);
+        return (bool)out;
+    }
+
+    // Text blob size: it ends with the last verse's text, or with the last
+    // book's name when that came after its verses in the JSON. A compressed
+    // corpus has no blob; this is then its names and chapters, inflated.
+    uint64_t textSize() const {
+        uint64_t size = 0;
+        if (!blocks_.empty()) {
+            for (const ChapterBlock& block : blocks_) size += block.rawSize;
+            return size + ownText_.size();
+        }
+        if (verseCount_ > 0) {
+            const VerseRecord& last = verses_[verseCount_ - 1];
+            size = (uint64_t)last.textOffset + last.textLength;
+        }
+        if (bookCount_ > 0) {
+            const BookRecord& last = books_[bookCount_ - 1];
+            size = std::max(size, (uint64_t)last.nameOffset + last.nameLength);
+        }
+        return size;
+    }
+
+private:
+    // Map (or, without mmap, read) a whole file of at least minSize bytes
+    const char* mapFile(const std::string& path, size_t minSize) {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)minSize) {
+            close(fd);
+            return nullptr;
+        }
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) return nullptr;
+        map_ = addr;
+        mapSize_ = st.st_size;
+        return static_cast<const char*>(addr);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return nullptr;
+        ownFile_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (ownFile_.size() < minSize) {
+            ownFile_.clear();
+            return nullptr;
+        }
+        mapSize_ = ownFile_.size();
+        return ownFile_.data();
+#endif
+    }
+
+    // Tables read from a file point inside themselves: books cover the
+    // chapters and chapters the verses in order, names lie inside
+    // namesSize bytes of text and verses inside textSize (a compressed
+    // corpus: inside their chapter's block), so no lookup can read out of
+    // bounds
+    bool validTables(uint64_t namesSize, uint64_t textSize) const {
+        uint64_t next = 0;
+        for (uint32_t b = 0; b < bookCount_; b++) {
+            const BookRecord& book = books_[b];
+            if ((uint64_t)book.nameOffset + book.nameLength > namesSize || book.firstChapter != next) return false;
+            next += book.chapterCount;
+        }
+        if (next != chapterCount_) return false;
+        next = 0;
+        for (uint32_t c = 0; c < chapterCount_; c++) {
+            const ChapterRecord& ch = chapters_[c];
+            if (ch.firstVerse != next || next + ch.verseCount > verseCount_) return false;
+            next += ch.verseCount;
+            const uint64_t size = blocks_.empty() ? textSize : blocks_[c].rawSize;
+            for (uint32_t v = ch.firstVerse; v < ch.firstVerse + ch.verseCount; v++) {
+                if ((uint64_t)verses_[v].textOffset + verses_[v].textLength > size) return false;
+            }
+        }
+        return next == verseCount_;
+    }
+
+    // Blocks of a compressed corpus lie inside its dataSize bytes of blocks
+    bool validBlocks(uint64_t dataSize) const {
+        for (const ChapterBlock& block : blocks_) {
+            if (block.offset > dataSize || block.size > dataSize - block.offset) return false;
+        }
+        return true;
+    }
+
+    // Inflate chapter c into buf and return its text. A corrupt block reads
+    // as NULs (loadCompressed() checked the sizes, not the deflate data).
+    const char* inflateChapter(uint32_t c, std::string& buf) const {
+        const ChapterBlock& block = blocks_[c];
+        buf.assign(block.rawSize, '\0');
+        if (block.rawSize && !inflateBlock({ static_cast<const char*>(map_ ? map_ : ownFile_.data()) + block.offset,
+                                             block.size }, dictionary_, &buf[0], buf.size())) {
+            std::fill(buf.begin(), buf.end(), '\0');
+            std::cerr << "Corrupt compressed chapter " << c << "\n";
+        }
+        return buf.data();
+    }
+
+    // Text of chapter c of a compressed corpus, inflated on first use and
+    // kept; safe to call from several threads
+    const char* chapterText(uint32_t c) const {
+        if (!blockReady_[c].load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(blockMutex_);
+            if (!blockReady_[c].load(std::memory_order_relaxed)) {
+                inflateChapter(c, chapterText_[c]);
+                residentText_ += chapterText_[c].size();
+                blockReady_[c].store(true, std::memory_order_release);
+            }
+        }
+        return chapterText_[c].data();
+    }
+
+    // "chapters": [{chapter, verses: [{verse, text}]}] of the last book
+    bool readChapters(JsonReader& in, std::string& missing) {
+        std::string key;
+        if (!in.beginArray()) return false;
+        while (in.nextElement() && in.beginObject()) {
+            ownChapters_.push_back({ 0, (uint32_t)ownVerses_.size(), 0 });
+            bool numbered = false;
+            while (in.nextKey(key)) {
+                if (key == "chapter") {
+                    if (!in.readUint(ownChapters_.back().number)) return false;
+                    numbered = true;
+                } else if (key == "verses") {
+                    if (!readVerses(in, missing)) return false;
+                } else if (!in.skipValue()) {
+                    return false;
+                }
+            }
+            if (in.failed() || !missing.empty()) return false;
+            if (!numbered) {
+                missing = "chapter number";
+                return false;
+            }
+            ownBooks_.back().chapterCount++;
+        }
+        return !in.failed();
+    }
+
+    // "verses": [{verse, text}] of the last chapter
+    bool readVerses(JsonReader& in, std::string& missing) {
+        std::string key;
+        if (!in.beginArray()) return false;
+        while (in.nextElement() && in.beginObject()) {
+            VerseRecord v{ 0, 0, 0 };
+            bool numbered = false, hasText = false;
+            while (in.nextKey(key)) {
+                if (key == "verse") {
+                    if (!in.readUint(v.number)) return false;
+                    numbered = true;
+                } else if (key == "text") {
+                    v.textOffset = ownText_.size();
+                    if (!in.readString(ownText_)) return false;
+                    v.textLength = ownText_.size() - v.textOffset;
+                    hasText = true;
+                } else if (!in.skipValue()) {
+                    return false;
+                }
+            }
+            if (in.failed()) return false;
+            if (!numbered || !hasText) {
+                missing = numbered ? "verse text" : "verse number";
+                return false;
+            }
+            ownVerses_.push_back(v);
+            ownChapters_.back().verseCount++;
+        }
+        return !in.failed();
+    }
+
+    // Unmapped and with no owned tables
+    void reset() {
+        unmap();
+        ownBooks_.clear();
+        ownChapters_.clear();
+        ownVerses_.clear();
+        ownText_.clear();
+        blocks_.clear();
+        dictionary_ = {};
+        chapterText_.clear();
+        blockReady_.reset();
+        residentText_ = 0;
+        source_ = {};
+    }
+
+    // Point the tables at the owned storage
+    void adopt() {
+        ownText_.shrink_to_fit();
+        ownBooks_.shrink_to_fit();
+        ownChapters_.shrink_to_fit();
+        ownVerses_.shrink_to_fit();
+        books_ = ownBooks_.data();
+        chapters_ = ownChapters_.data();
+        verses_ = ownVerses_.data();
+        text_ = ownText_.data();
+        bookCount_ = ownBooks_.size();
+        chapterCount_ = ownChapters_.size();
+        verseCount_ = ownVerses_.size();
+    }
+
+    void unmap() {
+#ifndef _WIN32
+        if (map_) munmap(map_, mapSize_);
+#endif
+        map_ = nullptr;
+        mapSize_ = 0;
+        ownFile_.clear();
+        books_ = nullptr;
+        chapters_ = nullptr;
+        verses_ = nullptr;
+        text_ = nullptr;
+        bookCount_ = chapterCount_ = verseCount_ = 0;
+    }
+
+    const BookRecord* books_ = nullptr;
+    const ChapterRecord* chapters_ = nullptr;
+    const VerseRecord* verses_ = nullptr;
+    const char* text_ = nullptr;
+    uint32_t bookCount_ = 0;
+    uint32_t chapterCount_ = 0;
+    uint32_t verseCount_ = 0;
+
+    void* map_ = nullptr;
+    size_t mapSize_ = 0;
+    std::string ownFile_;   // the file, where it cannot be mapped
+
+    // Backing storage when the corpus was built from JSON (or inflated
+    // from nabre.nbz, whose ownText_ holds only the book names)
+    std::vector<BookRecord> ownBooks_;
+    std::vector<ChapterRecord> ownChapters_;
+    std::vector<VerseRecord> ownVerses_;
+    std::string ownText_;
+
+    // Compressed corpus: per chapter, its block in the mapped file and, once
+    // read, its text
+    std::vector<ChapterBlock> blocks_;
+    std::string_view dictionary_;
+    mutable std::vector<std::string> chapterText_;
+    mutable std::unique_ptr<std::atomic<bool>[]> blockReady_;
+    mutable std::mutex blockMutex_;
+    mutable std::atomic<uint64_t> residentText_{ 0 };
+
+    JsonStamp source_;
+};
+
+// False, after a warning, if json is not the nabre.json that the corpus
+// just loaded from path was compiled from
+inline bool compiledCorpusCurrent(const Corpus& corpus, const std::string& path, const std::string& json) {
+    JsonStamp stamp;
+    if (!corpus.source().known() || !stampOf(json, stamp) || stamp == corpus.source()) return true;
+    std::cerr << "Skipping " << path << ", which is older than " << json << " (run `nabreterm compile " << json
+              << " -o " << path << "` to update it).\n";
+    return false;
+}
+
+// Where the corpus files are looked for, in order: cwd, then the data dir
+inline std::vector<std::string> corpusDirs() {
+    std::vector<std::string> dirs = { "." };
+    if (std::string(NABRETERM_DATADIR) != ".") dirs.push_back(NABRETERM_DATADIR);
+    return dirs;
+}
+
+// A compiled corpus: nabre.bin (cwd, then data dir), else nabre.nbz, skipping
+// those compiled from an older nabre.json than the one beside them
+inline bool loadCompiledCorpus(Corpus& corpus) {
+    for (const std::string file : { "nabre.bin", "nabre.nbz" }) {
+        for (const std::string& dir : corpusDirs()) {
+            const std::string prefix = dir == "." ? "" : dir + "/";
+            const std::string path = prefix + file;
+            const bool loaded = file == "nabre.bin" ? corpus.loadBinary(path) : corpus.loadCompressed(path);
+            if (loaded && compiledCorpusCurrent(corpus, path, prefix + "nabre.json")) return true;
+        }
+    }
+    return false;
+}
+
+// Locate and load the corpus: a compiled one first, and nabre.json only
+// when none is present.
+inline bool loadCorpus(Corpus& corpus) {
+    if (loadCompiledCorpus(corpus)) return true;
+    const std::string dataDir = NABRETERM_DATADIR;
+    for (const std::string& path : { std::string("nabre.json"), dataDir + "/nabre.json" }) {
+        if (corpus.loadJson(path)) return true;
+    }
+    std::cerr << "Could not open NABRE JSON file.\n";
+    return false;
+}
+
+// Append a string the way nlohmann::json serialises it, so that output
+// produced from the flat corpus matches what the DOM used to print.
+inline void appendQuoted(std::string& out, std::string_view s) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof buf, "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    out += '"';
+}
+
+inline void writeQuoted(std::ostream& out, std::string_view s) {
+    std::string quoted;
+    appendQuoted(quoted, s);
+    out << quoted;
+}
+
+#endif // NABRETERM_CORPUS_HPP
@@ -0,0 +1,405 @@
+// daemon.hpp
+// Unix-socket daemon and client for one-shot nabreterm commands.
+//
+// `nabreterm --serve [PATH]` keeps the corpus and indexes loaded and answers
+// requests on a Unix domain socket, a bounded number of clients at a time,
+// each on its own thread. A request is one line holding the command's
+// arguments:
+//   run \t <stdout is a tty: 0|1> \t <data files> \t <arg> \t <arg> ... \n
+// with tab, newline and backslash inside fields escaped as \t, \n, \\. The
+// data files are what the client would load (see runServer()); the reply
+// replays the command's output in the order it was written:
+//   out <length>\n<bytes>      stdout
+//   err <length>\n<bytes>      stderr
+//   exit <status>\n            end of reply
+// or is just "refuse\n" when the daemon loaded other data files.
+// One-shot commands try the daemon first and run in-process when nothing is
+// listening, or only a daemon that refuses them or that belongs to another
+// user, so the daemon only ever saves the startup cost.
+#ifndef NABRETERM_DAEMON_HPP
+#define NABRETERM_DAEMON_HPP
+
+#include "output.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0      // macOS: SO_NOSIGPIPE is set on the socket instead
+#endif
+#endif
+
+#ifndef _WIN32
+// dir is a directory (not a link to one) that only this user can enter
+inline bool privateDirectory(const std::string& dir) {
+    struct stat st;
+    return ::lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == ::geteuid()
+           && (st.st_mode & 077) == 0;
+}
+#endif
+
+// $NABRETERM_SOCKET when set (empty turns forwarding off), otherwise a
+// per-user socket in the runtime directory or, without one, in a private
+// /tmp/nabreterm-<uid> directory (made when create is set). Empty when that
+// directory exists but is not private.
+inline std::string defaultSocketPath(bool create = false) {
+    if (const char* path = std::getenv("NABRETERM_SOCKET")) return path;
+#ifdef _WIN32
+    (void)create;
+    return "";
+#else
+    if (const char* dir = std::getenv("XDG_RUNTIME_DIR")) {
+        if (*dir) return std::string(dir) + "/nabreterm.sock";
+    }
+    const std::string dir = "/tmp/nabreterm-" + std::to_string(::geteuid());
+    if (create) ::mkdir(dir.c_str(), 0700);
+    struct stat st;
+    if (::lstat(dir.c_str(), &st) != 0 && errno == ENOENT) return dir + "/nabreterm.sock";   // no daemon
+    return privateDirectory(dir) ? dir + "/nabreterm.sock" : "";
+#endif
+}
+
+// --- Request line ---
+inline std::string encodeRequest(const std::string& dataFiles, const std::vector<std::string>& args, bool tty) {
+    std::string line = tty ? "run\t1" : "run\t0";
+    auto field = [&](const std::string& value) {
+        line += '\t';
+        for (char c : value) {
+            if (c == '\t') line += "\\t";
+            else if (c == '\n') line += "\\n";
+            else if (c == '\\') line += "\\\\";
+            else line += c;
+        }
+    };
+    field(dataFiles);
+    for (const std::string& arg : args) field(arg);
+    return line + "\n";
+}
+
+inline bool decodeRequest(const std::string& line, std::string& dataFiles, std::vector<std::string>& args,
+                          bool& tty) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (c == '\t') {
+            fields.emplace_back();
+        } else if (c == '\\' && i + 1 < line.size()) {
+            c = line[++i];
+            fields.back() += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+        } else {
+            fields.back() += c;
+        }
+    }
+    if (fields.size() < 3 || fields[0] != "run" || (fields[1] != "0" && fields[1] != "1")) return false;
+    tty = fields[1] == "1";
+    dataFiles = fields[2];
+    args.assign(fields.begin() + 3, fields.end());
+    return true;
+}
+
+// Runs one request: args as typed after the program name, tty for the
+// client's stdout. Returns the exit status.
+using RequestHandler = std::function<int(std::vector<std::string>& args, bool tty,
+                                         std::ostream& out, std::ostream& err)>;
+
+#ifndef _WIN32
+
+inline bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Buffered reads of lines and fixed-size payloads from a socket
+class SocketReader {
+public:
+    explicit SocketReader(int fd) : fd_(fd) {}
+
+    bool line(std::string& out, size_t limit = 1 << 20) {
+        out.clear();
+        while (true) {
+            size_t nl = buffer_.find('\n', pos_);
+            if (nl != std::string::npos) {
+                out.assign(buffer_, pos_, nl - pos_);
+                pos_ = nl + 1;
+                return true;
+            }
+            if (buffer_.size() - pos_ > limit || !fill()) return false;
+        }
+    }
+
+    bool bytes(std::string& out, size_t count) {
+        while (buffer_.size() - pos_ < count) {
+            if (!fill()) return false;
+        }
+        out.assign(buffer_, pos_, count);
+        pos_ += count;
+        return true;
+    }
+
+private:
+    bool fill() {
+        buffer_.erase(0, pos_);
+        pos_ = 0;
+        char chunk[65536];
+        ssize_t n;
+        do { n = ::recv(fd_, chunk, sizeof chunk, 0); } while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+        buffer_.append(chunk, n);
+        return true;
+    }
+
+    int fd_;
+    std::string buffer_;
+    size_t pos_ = 0;
+};
+
+inline bool socketAddress(const std::string& path, sockaddr_un& addr) {
+    if (path.empty() || path.size() >= sizeof addr.sun_path) return false;
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, path.size());
+    return true;
+}
+
+// The socket at path was made by this user, and the process at the other
+// end of fd, connected to it, runs as this user
+inline bool socketIsOurs(const std::string& path) {
+    struct stat st;
+    return ::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) && st.st_uid == ::geteuid();
+}
+
+inline bool peerIsUs(int fd) {
+#ifdef __linux__
+    ucred cred;
+    socklen_t length = sizeof cred;
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) == 0 && cred.uid == ::geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::geteuid();
+#endif
+}
+
+inline int connectSocket(const std::string& path) {
+    sockaddr_un addr;
+    if (!socketAddress(path, addr)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// --- Client ---
+// Send args to the daemon at path and replay its reply on stdout/stderr.
+// dataFiles describes the files this process would load; a daemon that
+// loaded others refuses. False when no daemon of this user's answered and
+// nothing was printed, in which case the caller runs the command itself.
+inline bool forwardToDaemon(const std::string& path, const std::string& dataFiles,
+                            const std::vector<std::string>& args, bool tty, int& status) {
+    if (path.empty()) return false;
+    int fd = connectSocket(path);
+    if (fd < 0) return false;
+    if (!socketIsOurs(path) || !peerIsUs(fd)) {
+        ::close(fd);
+        std::cerr << "Ignoring " << path << ": it belongs to another user\n";
+        return false;
+    }
+    std::string request = encodeRequest(dataFiles, args, tty);
+    if (!writeAll(fd, request.data(), request.size())) {
+        ::close(fd);
+        return false;
+    }
+
+    SocketReader reader(fd);
+    std::string header, payload;
+    bool printed = false;
+    while (reader.line(header)) {
+        if (header == "refuse" && !printed) break;
+        if (header.rfind("exit ", 0) == 0) {
+            status = std::atoi(header.c_str() + 5);
+            ::close(fd);
+            return true;
+        }
+        bool toOut = header.rfind("out ", 0) == 0;
+        if (!toOut && header.rfind("err ", 0) != 0) break;
+        if (!reader.bytes(payload, std::strtoul(header.c_str() + 4, nullptr, 10))) break;
+        std::FILE* stream = toOut ? stdout : stderr;
+        std::fwrite(payload.data(), 1, payload.size(), stream);
+        std::fflush(stream);
+        printed = true;
+    }
+    ::close(fd);
+    if (!printed) return false;
+    std::cerr << "Lost connection to nabreterm daemon at " << path << "\n";
+    status = 1;
+    return true;
+}
+
+// --- Server ---
+inline std::string& servedSocketPath() {
+    static std::string path;
+    return path;
+}
+
+inline void stopServing(int) {
+    ::unlink(servedSocketPath().c_str());
+    std::_Exit(0);
+}
+
+// A client that sends nothing (or stops reading) for this long is dropped
+constexpr int CLIENT_TIMEOUT_SECONDS = 10;
+
+inline void serveClient(int fd, const std::string& dataFiles, const RequestHandler& handler) {
+    SocketReader reader(fd);
+    std::string line, clientFiles;
+    std::vector<std::string> args;
+    bool tty = false;
+    CapturedOutput reply;
+    int status = 1;
+    if (!reader.line(line) || !decodeRequest(line, clientFiles, args, tty)) {
+        reply.err() << "Bad request.\n";
+    } else if (clientFiles != dataFiles) {
+        writeAll(fd, "refuse\n", 7);
+        ::close(fd);
+        return;
+    } else {
+        status = handler(args, tty, reply.out(), reply.err());
+    }
+    std::string bytes;
+    for (auto& frame : reply.frames()) {
+        bytes += (frame.first ? "err " : "out ") + std::to_string(frame.second.size()) + "\n";
+        bytes += frame.second;
+    }
+    bytes += "exit " + std::to_string(status) + "\n";
+    writeAll(fd, bytes.data(), bytes.size());
+    ::close(fd);
+}
+
+// Listen on path until SIGINT/SIGTERM, answering the requests whose data
+// files match dataFiles, at most maxClients at once (the rest wait in the
+// listen backlog); returns only on setup errors
+inline int serveSocket(const std::string& path, const std::string& dataFiles, unsigned maxClients,
+                       const RequestHandler& handler) {
+    sockaddr_un addr;
+    if (!socketAddress(path, addr)) {
+        std::cerr << "Invalid socket path: " << path << "\n";
+        return 1;
+    }
+    int probe = connectSocket(path);
+    if (probe >= 0) {
+        ::close(probe);
+        std::cerr << "A nabreterm daemon is already listening on " << path << "\n";
+        return 1;
+    }
+    ::unlink(path.c_str());     // stale socket from a daemon that died
+
+    // Made 0600 (this user only) from the start: no window in which
+    // another user could connect
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    const mode_t mask = ::umask(077);
+    const bool bound = fd >= 0 && ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == 0;
+    ::umask(mask);
+    if (!bound || ::chmod(path.c_str(), 0600) != 0 || ::listen(fd, 64) != 0) {
+        std::cerr << "Could not listen on " << path << "\n";
+        if (bound) ::unlink(path.c_str());
+        if (fd >= 0) ::close(fd);
+        return 1;
+    }
+
+    servedSocketPath() = path;
+    std::signal(SIGINT, stopServing);
+    std::signal(SIGTERM, stopServing);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cerr << "Serving on " << path << "\n";
+
+    // Shared with the client threads, which may outlive this frame
+    struct Slots {
+        std::mutex mutex;
+        std::condition_variable freed;
+        unsigned busy = 0;
+    };
+    auto slots = std::make_shared<Slots>();
+    const timeval timeout = { CLIENT_TIMEOUT_SECONDS, 0 };
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(slots->mutex);
+            slots->freed.wait(lock, [&] { return slots->busy < maxClients; });
+        }
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));   // until clients close
+                continue;
+            }
+            std::cerr << "accept failed\n";
+            ::close(fd);
+            ::unlink(path.c_str());
+            // The clients still running use the caller's state through
+            // handler, which goes away once this returns
+            std::unique_lock<std::mutex> lock(slots->mutex);
+            slots->freed.wait(lock, [&] { return slots->busy == 0; });
+            return 1;
+        }
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+        {
+            std::lock_guard<std::mutex> lock(slots->mutex);
+            slots->busy++;
+        }
+        std::thread([client, slots, dataFiles, &handler] {
+            serveClient(client, dataFiles, handler);
+            {
+                std::lock_guard<std::mutex> lock(slots->mutex);
+                slots->busy--;
+            }
+            slots->freed.notify_all();
+        }).detach();
+    }
+}
+
+#else // _WIN32: no daemon, every command runs in-process
+
+inline bool forwardToDaemon(const std::string&, const std::string&, const std::vector<std::string>&, bool, int&) {
+    return false;
+}
+
+inline int serveSocket(const std::string&, const std::string&, unsigned, const RequestHandler&) {
+    std::cerr << "--serve is not supported on this platform.\n";
+    return 1;
+}
+
+#endif
+
+#endif // NABRETERM_DAEMON_HPP
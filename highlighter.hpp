@@ -0,0 +1,197 @@
+// highlighter.hpp
+// Search-match highlighting shared by nabreterm and nabretermui.
+//
+// A Highlighter is built once per query. Its literal patterns (keywords,
+// nabretermui's needle) go into one Aho–Corasick automaton, kept as a dense
+// byte-transition table, so a verse's folded text is scanned in a single
+// pass however many terms the query has. Keywords match like their
+// `\b<kw>\w*\b` regex: only at the start of a word, running to its end.
+// Regex keywords, which no automaton can hold, are run as regexes. Every
+// match is mapped back to the original text (text_fold.hpp), and the
+// ranges of all terms (and the phrase and NEAR words, which come from the
+// index) are merged before anything is emitted, so overlapping terms make
+// one highlight and the output is appended to its buffer in one pass.
+#ifndef NABRETERM_HIGHLIGHTER_HPP
+#define NABRETERM_HIGHLIGHTER_HPP
+
+#include "query_plan.hpp"
+#include "text_fold.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using ByteRange = std::pair<size_t, size_t>;   // [first, second)
+
+// Sort ranges and join those that overlap or touch
+inline void mergeRanges(std::vector<ByteRange>& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    size_t kept = 0;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (kept > 0 && ranges[i].first <= ranges[kept - 1].second) {
+            ranges[kept - 1].second = std::max(ranges[kept - 1].second, ranges[i].second);
+        } else {
+            ranges[kept++] = ranges[i];
+        }
+    }
+    ranges.resize(kept);
+}
+
+// Call fn(piece, marked) for the pieces of text in and between ranges
+// (merged, as mergeRanges() leaves them), in order
+template <class Fn>
+void forEachHighlightPiece(std::string_view text, const std::vector<ByteRange>& ranges, Fn fn) {
+    size_t pos = 0;
+    for (const ByteRange& r : ranges) {
+        if (r.first > pos) fn(text.substr(pos, r.first - pos), false);
+        fn(text.substr(r.first, r.second - r.first), true);
+        pos = r.second;
+    }
+    if (pos < text.size()) fn(text.substr(pos), false);
+}
+
+// Append text to out with the ranges wrapped in open ... close
+inline void appendHighlighted(std::string& out, std::string_view text, const std::vector<ByteRange>& ranges,
+                              std::string_view open, std::string_view close) {
+    forEachHighlightPiece(text, ranges, [&](std::string_view piece, bool marked) {
+        if (marked) out += open;
+        out += piece;
+        if (marked) out += close;
+    });
+}
+
+class Highlighter {
+public:
+    // The plan's keywords, outside a NEAR (whose matched words come from
+    // the index), and its substring term
+    static Highlighter forQuery(const QueryPlan& plan) {
+        Highlighter h;
+        for (const QueryTerm& term : plan.terms()) {
+            if (term.operand) continue;
+            switch (term.kind) {
+                case TermKind::Prefix: h.addLiteral(term.folded, true); break;
+                case TermKind::Substring: h.addLiteral(term.folded, false); break;
+                case TermKind::Regex: h.regexes_.push_back(term.pattern); break;
+                default: break;
+            }
+        }
+        h.build();
+        return h;
+    }
+
+    bool empty() const { return patterns_.empty() && regexes_.empty(); }
+
+    // Append the original byte ranges of every match in verse (unmerged)
+    void find(const FoldedView& verse, std::vector<ByteRange>& ranges) const {
+        const size_t first = ranges.size();
+        findFolded(verse.text, ranges);
+        for (size_t i = first; i < ranges.size(); i++) {
+            ranges[i] = verse.originalRange(ranges[i].first, ranges[i].second);
+        }
+    }
+
+    // Append the ranges of every match in folded text
+    void findFolded(std::string_view text, std::vector<ByteRange>& ranges) const {
+        if (!patterns_.empty()) {
+            uint32_t state = 0;
+            for (size_t i = 0; i < text.size(); i++) {
+                state = next_[state * 256 + uint8_t(text[i])];
+                for (uint32_t s = ends_[state].empty() ? link_[state] : state; s != NONE; s = link_[s]) {
+                    for (uint32_t p : ends_[s]) {
+                        size_t begin = i + 1 - patterns_[p].length, end = i + 1;
+                        if (patterns_[p].word) {
+                            if (begin > 0 && isWordChar(text[begin - 1])) continue;
+                            while (end < text.size() && isWordChar(text[end])) end++;
+                        }
+                        ranges.push_back({ begin, end });
+                    }
+                }
+            }
+        }
+        for (const std::regex& pattern : regexes_) {
+            using Iterator = std::regex_iterator<std::string_view::const_iterator>;
+            for (Iterator it(text.begin(), text.end(), pattern), end; it != end; ++it) {
+                ranges.push_back({ size_t(it->position()), size_t(it->position() + it->length()) });
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Pattern {
+        size_t length;
+        bool word;   // starts a word and runs to its end
+    };
+
+    // Trie edges first; build() completes them into the automaton
+    void addLiteral(const std::string& literal, bool word) {
+        if (literal.empty()) return;
+        if (next_.empty()) addState();
+        uint32_t state = 0;
+        for (char c : literal) {
+            uint32_t& edge = next_[state * 256 + uint8_t(c)];
+            if (edge == NONE) {
+                const uint32_t child = addState();
+                next_[state * 256 + uint8_t(c)] = child;
+                state = child;
+            } else {
+                state = edge;
+            }
+        }
+        ends_[state].push_back(patterns_.size());
+        patterns_.push_back({ literal.size(), word });
+    }
+
+    uint32_t addState() {
+        next_.resize(next_.size() + 256, NONE);
+        ends_.emplace_back();
+        link_.push_back(NONE);
+        return ends_.size() - 1;
+    }
+
+    // Breadth first: each state's failure state is shallower, so complete
+    // by then. Missing edges become the failure state's, and link_ points
+    // at the longest proper suffix state that ends a pattern.
+    void build() {
+        if (next_.empty()) return;
+        std::vector<uint32_t> fail(ends_.size(), 0);
+        std::queue<uint32_t> queue;
+        for (int c = 0; c < 256; c++) {
+            uint32_t& edge = next_[c];
+            if (edge == NONE) {
+                edge = 0;
+            } else {
+                queue.push(edge);
+            }
+        }
+        while (!queue.empty()) {
+            const uint32_t state = queue.front();
+            queue.pop();
+            const uint32_t f = fail[state];
+            link_[state] = ends_[f].empty() ? link_[f] : f;
+            for (int c = 0; c < 256; c++) {
+                uint32_t& edge = next_[state * 256 + c];
+                if (edge == NONE) {
+                    edge = next_[f * 256 + c];
+                } else {
+                    fail[edge] = next_[f * 256 + c];
+                    queue.push(edge);
+                }
+            }
+        }
+    }
+
+    std::vector<Pattern> patterns_;
+    std::vector<uint32_t> next_;                  // 256 per state
+    std::vector<std::vector<uint32_t>> ends_;     // patterns ending at each state
+    std::vector<uint32_t> link_;                  // next state ending a pattern, along the failure chain
+    std::vector<std::regex> regexes_;
+};
+
+#endif // NABRETERM_HIGHLIGHTER_HPP
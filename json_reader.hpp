@@ -0,0 +1,261 @@
+// json_reader.hpp
+// Small pull parser for the JSON nabreterm reads (nabre.json, books.json).
+//
+// Nothing is materialized: the caller walks the document with beginArray()/
+// nextElement() and beginObject()/nextKey(), and strings are decoded straight
+// into a buffer it owns (the corpus appends verse text to its arena this
+// way), so reading the Bible costs no per-value allocation. Values the
+// caller does not want are skipped with skipValue(). The first error stops
+// the reader: every call then returns false and error() says where.
+#ifndef NABRETERM_JSON_READER_HPP
+#define NABRETERM_JSON_READER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view input) : in_(input) {}
+
+    bool failed() const { return !error_.empty(); }
+    const std::string& error() const { return error_; }
+    // Byte offset of the next unread character
+    size_t offset() const { return pos_; }
+
+    // '[': then call nextElement() before each element
+    bool beginArray() { return open('['); }
+
+    // Whether another element follows (consuming the ',' or the closing ']')
+    bool nextElement() { return next(']'); }
+
+    // '{': then call nextKey() before each value
+    bool beginObject() { return open('{'); }
+
+    // The next key and its ':', or false at the closing '}'
+    bool nextKey(std::string& key) {
+        if (!next('}')) return false;
+        key.clear();
+        if (!readString(key)) return false;
+        skipSpace();
+        return expect(':');
+    }
+
+    // Append a string value, unescaped, to out
+    bool readString(std::string& out) {
+        skipSpace();
+        if (!expect('"')) return false;
+        while (pos_ < in_.size()) {
+            size_t run = pos_;
+            while (run < in_.size() && in_[run] != '"' && in_[run] != '\\') run++;
+            out.append(in_.data() + pos_, run - pos_);
+            pos_ = run;
+            if (pos_ == in_.size()) break;
+            if (in_[pos_++] == '"') return true;
+            if (!readEscape(out)) return false;
+        }
+        return fail("unterminated string");
+    }
+
+    // A non-negative integer value (a number such as 3.0 is accepted too)
+    bool readUint(uint32_t& value) {
+        skipSpace();
+        size_t start = pos_;
+        while (pos_ < in_.size() && isNumberChar(in_[pos_])) pos_++;
+        std::string number(in_.substr(start, pos_ - start));
+        char* end = nullptr;
+        double d = number.empty() ? -1 : std::strtod(number.c_str(), &end);
+        if (number.empty() || end != number.c_str() + number.size() || d < 0 || d > UINT32_MAX) {
+            pos_ = start;
+            return fail("expected a non-negative number");
+        }
+        value = uint32_t(d);
+        return true;
+    }
+
+    // Skip one value of any type
+    bool skipValue() {
+        skipSpace();
+        if (pos_ >= in_.size()) return fail("unexpected end of input");
+        const char c = in_[pos_];
+        std::string key, scratch;
+        if (c == '{') {
+            if (!beginObject()) return false;
+            while (nextKey(key)) {
+                if (!skipValue()) return false;
+            }
+            return !failed();
+        }
+        if (c == '[') {
+            if (!beginArray()) return false;
+            while (nextElement()) {
+                if (!skipValue()) return false;
+            }
+            return !failed();
+        }
+        if (c == '"') return readString(scratch);
+        for (std::string_view word : { "true", "false", "null" }) {
+            if (in_.substr(pos_, word.size()) == word) {
+                pos_ += word.size();
+                return true;
+            }
+        }
+        size_t start = pos_;
+        while (pos_ < in_.size() && isNumberChar(in_[pos_])) pos_++;
+        return pos_ > start || fail("unexpected character");
+    }
+
+    // Only whitespace may follow the document
+    bool finish() {
+        skipSpace();
+        if (failed()) return false;
+        return pos_ == in_.size() || fail("trailing characters");
+    }
+
+private:
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static bool isNumberChar(char c) {
+        return isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    void skipSpace() {
+        while (pos_ < in_.size() && (in_[pos_] == ' ' || in_[pos_] == '\n' || in_[pos_] == '\r' || in_[pos_] == '\t')) {
+            pos_++;
+        }
+    }
+
+    bool fail(const char* what) {
+        if (error_.empty()) error_ = std::string(what) + " at byte " + std::to_string(pos_);
+        return false;
+    }
+
+    bool expect(char c) {
+        if (failed()) return false;
+        if (pos_ < in_.size() && in_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return fail(c == ':' ? "expected ':'" : c == '"' ? "expected a string" : "unexpected character");
+    }
+
+    bool open(char bracket) {
+        skipSpace();
+        if (!expect(bracket)) return false;
+        first_.push_back(true);
+        return true;
+    }
+
+    bool next(char close) {
+        if (failed() || first_.empty()) return false;
+        skipSpace();
+        if (pos_ < in_.size() && in_[pos_] == close) {
+            pos_++;
+            first_.pop_back();
+            return false;
+        }
+        if (!first_.back() && !expect(',')) return false;
+        first_.back() = false;
+        return true;
+    }
+
+    // After a backslash
+    bool readEscape(std::string& out) {
+        if (pos_ >= in_.size()) return fail("unterminated string");
+        switch (in_[pos_++]) {
+            case '"':  out += '"'; return true;
+            case '\\': out += '\\'; return true;
+            case '/':  out += '/'; return true;
+            case 'b':  out += '\b'; return true;
+            case 'f':  out += '\f'; return true;
+            case 'n':  out += '\n'; return true;
+            case 'r':  out += '\r'; return true;
+            case 't':  out += '\t'; return true;
+            case 'u':  break;
+            default:   return fail("invalid escape");
+        }
+        uint32_t code = 0;
+        if (!readHex(code)) return false;
+        if (code >= 0xD800 && code < 0xDC00) {
+            uint32_t low = 0;
+            if (in_.substr(pos_, 2) != "\\u") return fail("unpaired surrogate");
+            pos_ += 2;
+            if (!readHex(low)) return false;
+            if (low < 0xDC00 || low >= 0xE000) return fail("unpaired surrogate");
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        appendUtf8(out, code);
+        return true;
+    }
+
+    bool readHex(uint32_t& code) {
+        if (pos_ + 4 > in_.size()) return fail("invalid \\u escape");
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = in_[pos_++];
+            code <<= 4;
+            if (isDigit(c)) code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += char(code);
+        } else if (code < 0x800) {
+            out += char(0xC0 | code >> 6);
+            out += char(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += char(0xE0 | code >> 12);
+            out += char(0x80 | (code >> 6 & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        } else {
+            out += char(0xF0 | code >> 18);
+            out += char(0x80 | (code >> 12 & 0x3F));
+            out += char(0x80 | (code >> 6 & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+    }
+
+    std::string_view in_;
+    size_t pos_ = 0;
+    std::vector<bool> first_;   // per open container: no element read yet
+    std::string error_;
+};
+
+// Whole file as a string; false if it cannot be opened
+inline bool readFile(const std::string& path, std::string& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// A JSON array of strings (books.json); false with the reader's error
+// (or "" if the file is missing) otherwise
+inline bool readStringArray(const std::string& path, std::vector<std::string>& items, std::string& error) {
+    std::string data;
+    error.clear();
+    if (!readFile(path, data)) return false;
+    JsonReader in(data);
+    items.clear();
+    if (in.beginArray()) {
+        while (in.nextElement()) {
+            items.emplace_back();
+            if (!in.readString(items.back())) break;
+        }
+    }
+    if (!in.finish()) {
+        error = in.error();
+        return false;
+    }
+    return true;
+}
+
+#endif // NABRETERM_JSON_READER_HPP
@@ -0,0 +1,112 @@
+// levenshtein.hpp
+// Bounded edit distance used for fuzzy book names and fuzzy search terms.
+//
+// Every caller only needs to know whether two words are within a small
+// number of edits, so the kernel is bounded: it returns the exact distance
+// when it is <= maxDist and maxDist + 1 otherwise, bailing out as soon as the
+// bound can no longer be met. Words of up to 64 bytes use Hyyrö's
+// bit-parallel form of Myers' algorithm (one 64-bit column per text byte,
+// no heap allocation); longer ones fall back to a banded DP.
+// Comparison is ASCII case-insensitive, as before.
+#ifndef NABRETERM_LEVENSHTEIN_HPP
+#define NABRETERM_LEVENSHTEIN_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+inline unsigned char foldByte(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : (unsigned char)c;
+}
+
+// --- Band-limited DP for patterns longer than one machine word ---
+inline int bandedLevenshtein(std::string_view a, std::string_view b, int maxDist) {
+    const int n = a.size(), m = b.size();
+    const int inf = maxDist + 1;
+    std::vector<int> prev(m + 1), cur(m + 1);
+    for (int j = 0; j <= m; j++) prev[j] = std::min(j, inf);
+
+    for (int i = 1; i <= n; i++) {
+        int lo = std::max(1, i - maxDist), hi = std::min(m, i + maxDist);
+        std::fill(cur.begin(), cur.end(), inf);
+        cur[0] = std::min(i, inf);
+        int best = cur[0];
+        for (int j = lo; j <= hi; j++) {
+            int cost = foldByte(a[i-1]) == foldByte(b[j-1]) ? 0 : 1;
+            cur[j] = std::min({ prev[j] + 1, cur[j-1] + 1, prev[j-1] + cost, inf });
+            best = std::min(best, cur[j]);
+        }
+        if (best >= inf) return inf;
+        std::swap(prev, cur);
+    }
+    return prev[m];
+}
+
+// --- One pattern compared against many candidates ---
+// The per-byte match masks are built once, so checking a word against the
+// whole list of book names (or any other batch) costs one pass per candidate.
+class LevenshteinPattern {
+public:
+    explicit LevenshteinPattern(std::string_view pattern) : pattern_(pattern) {
+        if (pattern.size() > 64) return;
+        std::fill(std::begin(peq_), std::end(peq_), 0);
+        for (size_t i = 0; i < pattern.size(); i++) peq_[foldByte(pattern[i])] |= uint64_t(1) << i;
+    }
+
+    int distance(std::string_view text, int maxDist) const {
+        const int m = pattern_.size(), n = text.size();
+        if (std::abs(m - n) > maxDist) return maxDist + 1;
+        if (m == 0) return n;
+        if (m > 64) return bandedLevenshtein(pattern_, text, maxDist);
+        return myers(peq_, m, text, maxDist);
+    }
+
+    // Hyyrö's bit-vector recurrence for D[m][j]; peq[c] has bit i set when
+    // pattern[i] == c. Stops once even matching every remaining byte of the
+    // text could not bring the distance back within maxDist.
+    static int myers(const uint64_t* peq, int m, std::string_view text, int maxDist) {
+        const uint64_t last = uint64_t(1) << (m - 1);
+        const int n = text.size();
+        uint64_t pv = ~uint64_t(0), mv = 0;
+        int score = m;
+        for (int j = 0; j < n; j++) {
+            uint64_t eq = peq[foldByte(text[j])];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if (ph & last) score++;
+            else if (mh & last) score--;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            if (score - (n - j - 1) > maxDist) return maxDist + 1;
+        }
+        return score <= maxDist ? score : maxDist + 1;
+    }
+
+private:
+    std::string_view pattern_;
+    uint64_t peq_[256];
+};
+
+// Single comparison: only the mask entries a and b touch are initialised,
+// so this is cheap for the short words it is called on.
+inline int levenshtein(std::string_view a, std::string_view b, int maxDist) {
+    if (a.size() > b.size()) std::swap(a, b);      // pattern = shorter word
+    const int m = a.size(), n = b.size();
+    if (n - m > maxDist) return maxDist + 1;
+    if (m == 0) return n;
+    if (m > 64) return bandedLevenshtein(a, b, maxDist);
+
+    uint64_t peq[256];
+    for (char c : b) peq[foldByte(c)] = 0;
+    for (char c : a) peq[foldByte(c)] = 0;
+    for (int i = 0; i < m; i++) peq[foldByte(a[i])] |= uint64_t(1) << i;
+    return LevenshteinPattern::myers(peq, m, b, maxDist);
+}
+
+#endif // NABRETERM_LEVENSHTEIN_HPP
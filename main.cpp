@@ -9,20 +9,41 @@
 
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 #include <nlohmann/json.hpp>
 #include <sstream>
+#include <iomanip>
+#include <stack>
 #include <algorithm>
 #include <cctype>
 #include <regex>
 #include <map>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <stdexcept>
 #include <readline/readline.h>
 #include <readline/history.h>
-
+#include "book_index.hpp"
+#include "commands.hpp"
+#include "corpus.hpp"
+#include "daemon.hpp"
+#include "highlighter.hpp"
+#include "levenshtein.hpp"
+#include "output.hpp"
+#include "query_plan.hpp"
+#include "reference_index.hpp"
+#include "search_index.hpp"
+#include "stats.hpp"
+#include "text_fold.hpp"
+#include "thread_pool.hpp"
+#include "verse_sampler.hpp"
 
 using namespace std;
-using json = nlohmann::json;
-bool evalPostfix(const vector<string>& postfix, const string& text);
 
 //Clear Screen
 void clearScreen() {
@@ -33,134 +54,6 @@ void clearScreen() {
     #endif
 }
 
-// Utility: lowercase conversion
-string toLower(const string& s) {
-    string result = s;
-    transform(result.begin(), result.end(), result.begin(),
-              [](unsigned char c){ return tolower(c); });
-    return result;
-}
-
-// --- Safe stoi wrapper ---
-int safeStoi(const string& s) {
-    try {
-        return stoi(s);
-    } catch (...) {
-        cerr << "Invalid number: " << s << "\n";
-        return -1; // sentinel value
-    }
-}
-
-int levenshtein(const string& a, const string& b) {
-    int n = a.size(), m = b.size();
-    vector<vector<int>> dp(n+1, vector<int>(m+1));
-
-    for (int i = 0; i <= n; i++) dp[i][0] = i;
-    for (int j = 0; j <= m; j++) dp[0][j] = j;
-
-    for (int i = 1; i <= n; i++) {
-        for (int j = 1; j <= m; j++) {
-            int cost = (tolower(a[i-1]) == tolower(b[j-1])) ? 0 : 1;
-            dp[i][j] = min({ dp[i-1][j] + 1,     // deletion
-                dp[i][j-1] + 1,     // insertion
-                dp[i-1][j-1] + cost }); // substitution
-        }
-    }
-    return dp[n][m];
-}
-
-// --- Tokenizer: split into words, operators, parentheses ---
-vector<string> tokenize(const string& query) {
-    vector<string> tokens;
-    string token;
-
-    for (size_t i = 0; i < query.size(); i++) {
-        char c = query[i];
-
-        if (isspace(c)) {
-            if (!token.empty()) {
-                tokens.push_back(token);
-                token.clear();
-            }
-        }
-        else if (c == '(' || c == ')') {
-            if (!token.empty()) {
-                tokens.push_back(token);
-                token.clear();
-            }
-            tokens.push_back(string(1, c));
-        }
-        else if (c == '&' && i+1 < query.size() && query[i+1] == '&') {
-            if (!token.empty()) {
-                tokens.push_back(token);
-                token.clear();
-            }
-            tokens.push_back("&&");
-            i++; // skip second &
-        }
-        else if (c == '|' && i+1 < query.size() && query[i+1] == '|') {
-            if (!token.empty()) {
-                tokens.push_back(token);
-                token.clear();
-            }
-            tokens.push_back("||");
-            i++; // skip second |
-        }
-        else if (c == '!') {
-            if (!token.empty()) {
-                tokens.push_back(token);
-                token.clear();
-            }
-            tokens.push_back("!");
-        }
-        else {
-            token.push_back(c);
-        }
-    }
-
-    if (!token.empty()) tokens.push_back(token);
-    return tokens;
-}
-
-// --- Operator precedence helper ---
-int precedence(const string& op) {
-    if (op == "&&") return 2;
-    if (op == "||") return 1;
-    if (op == "!")  return 3;
-    return 0;
-}
-
-// --- Shunting-yard: infix → postfix ---
-vector<string> toPostfix(const vector<string>& tokens) {
-    vector<string> output;
-    stack<string> ops;
-    for (auto& tok : tokens) {
-        if (tok == "&&" || tok == "||" || tok == "!") {
-            while (!ops.empty() && precedence(ops.top()) >= precedence(tok)) {
-                output.push_back(ops.top());
-                ops.pop();
-            }
-            ops.push(tok);
-        } else if (tok == "(") {
-            ops.push(tok);
-        } else if (tok == ")") {
-            while (!ops.empty() && ops.top() != "(") {
-                output.push_back(ops.top());
-                ops.pop();
-            }
-            if (!ops.empty()) ops.pop(); // discard "("
-        } else {
-            output.push_back(tok); // keyword
-        }
-    }
-    while (!ops.empty()) {
-        output.push_back(ops.top());
-        ops.pop();
-    }
-    return output;
-}
-
-
 // Simple argument parser for flags (--book, --chapter, etc.)
 map<string,string> parseArgs(int argc, char* argv[]) {
     map<string,string> args;
@@ -174,296 +67,168 @@ map<string,string> parseArgs(int argc, char* argv[]) {
     return args;
 }
 
-bool isNewTestament(const string& book) {
-    static vector<string> ntBooks = {
-        "Matthew","Mark","Luke","John","Acts","Romans",
-        "1Corinthians","2Corinthians","Galatians","Ephesians","Philippians",
-        "Colossians","1Thessalonians","2Thessalonians","1Timothy","2Timothy",
-        "Titus","Philemon","Hebrews","James","1Peter","2Peter",
-        "1John","2John","3John","Jude","Revelation"
-    };
-    return find(ntBooks.begin(), ntBooks.end(), book) != ntBooks.end();
-}
-
-bool isDeuterocanonical(const string& book) {
-    static vector<string> deutBooks = {
-        "Tobit","Judith","Wisdom","Sirach","Baruch","1Maccabees","2Maccabees"
-    };
-    return find(deutBooks.begin(), deutBooks.end(), book) != deutBooks.end();
-}
-
-
-// Evaluate postfix expression on verse text
-bool evalPostfix(const vector<string>& postfix, const string& text) {
-    stack<bool> st;
-    string lowerText = toLower(text);
-
-    for (auto& token : postfix) {
-        if (token == "&&" || token == "||") {
-            if (st.size() < 2) return false;
-            bool b = st.top(); st.pop();
-            bool a = st.top(); st.pop();
-            st.push(token == "&&" ? (a && b) : (a || b));
-        } else if (token == "!") {
-            if (st.empty()) return false;
-            bool a = st.top(); st.pop();
-            st.push(!a);
-        } else {
-            // Fuzzy match for keywords
-            bool wordMatch = false;
-            regex wordPattern("\\b" + toLower(token) + "\\w*\\b", regex_constants::icase);
-            if (regex_search(lowerText, wordPattern)) {
-                wordMatch = true;
-            } else {
-                istringstream iss(lowerText);
-                string word;
-                while (iss >> word) {
-                    if (levenshtein(word, toLower(token)) <= 2) {
-                        wordMatch = true;
-                        break;
-                    }
-                }
-            }
-            st.push(wordMatch);
+// Remove "--flag value" from argv and return the value ("" if absent), so the
+// positional parsing in main() never sees option flags
+string takeOption(int& argc, char* argv[], const string& flag) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (argv[i] == flag) {
+            string value = argv[i+1];
+            for (int j = i; j + 2 < argc; j++) argv[j] = argv[j+2];
+            argc -= 2;
+            argv[argc] = nullptr;
+            return value;
         }
     }
-    return !st.empty() && st.top();
+    return "";
 }
 
-// -- Unified Search Engine --
-void searchEngine(json& bible, const string& query, const string& scopeBook = "") {
-    vector<string> toks = tokenize(query);
-    bool found = false;
-
-    // Convert to postfix for operator search
-    vector<string> postfix = toPostfix(toks);
-
-    for (auto& b : bible) {
-        if (!scopeBook.empty() && toLower(b["book"]) != toLower(scopeBook)) continue;
-
-        for (auto& ch : b["chapters"]) {
-            for (auto& v : ch["verses"]) {
-                string text = v["text"];
-                string lowerText = toLower(text);
-                bool match = false;
-
-                // Evaluate postfix if operators are present
-                if (!postfix.empty()) {
-                    match = evalPostfix(postfix, text);
-                } else {
-                    // fallback: all tokens must appear (with fuzzy matching)
-                    match = true;
-                    for (auto& k : toks) {
-                        if (k == "&&" || k == "||" || k == "!" || k == "(" || k == ")") continue;
-
-                        bool wordMatch = false;
-                        regex wordPattern("\\b" + toLower(k) + "\\w*\\b", regex_constants::icase);
-                        if (regex_search(lowerText, wordPattern)) {
-                            wordMatch = true;
-                        } else {
-                            // Fuzzy check against each word in the verse
-                            istringstream iss(lowerText);
-                            string word;
-                            while (iss >> word) {
-                                if (levenshtein(word, toLower(k)) <= 2) {
-                                    wordMatch = true;
-                                    break;
-                                }
-                            }
-                        }
-
-                        if (!wordMatch) { match = false; break; }
-                    }
-                }
-
-                if (match) {
-                    string highlighted = text;
-
-                    // Only highlight if NOT operator is not used
-                    if (query.find("!") == string::npos) {
-                        for (auto& k : toks) {
-                            if (k == "&&" || k == "||" || k == "!" || k == "(" || k == ")") continue;
-                            regex wordPattern("\\b" + toLower(k) + "\\w*\\b", regex_constants::icase);
-                            sregex_iterator it(lowerText.begin(), lowerText.end(), wordPattern);
-                            sregex_iterator end;
-                            size_t offset = 0;
-                            for (; it != end; ++it) {
-                                size_t pos = it->position() + offset;
-                                string matchStr = it->str();
-                                highlighted.replace(pos, matchStr.length(),
-                                                    "\033[1;31m" + matchStr + "\033[0m");
-                                offset += 9; // account for escape codes
-                            }
-                        }
-                    }
-
-                    cout << "\033[1;34m" << b["book"] << " "
-                    << "\033[32m" << ch["chapter"] << ":" << v["verse"]
-                    << "\033[0m → " << highlighted << "\n";
-                    found = true;
-                }
-            }
+// Remove "--flag [value]" from argv, where the value is optional (the next
+// argument unless it is another option). False if the flag is absent.
+bool takeFlag(int& argc, char* argv[], const string& flag, string& value) {
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] != flag) continue;
+        int taken = 1;
+        value.clear();
+        if (i + 1 < argc && string(argv[i+1]).rfind("--", 0) != 0) {
+            value = argv[i+1];
+            taken = 2;
         }
+        for (int j = i; j + taken < argc; j++) argv[j] = argv[j+taken];
+        argc -= taken;
+        argv[argc] = nullptr;
+        return true;
     }
-
-    if (!found) {
-        cerr << "Error: No matches found.\n";
-    }
+    return false;
 }
 
-// Helper: resolve book name with fuzzy matching
-string resolveBook(const json& bible, const string& input) {
-    string bestBook;
-    int bestDist = 999;
-    for (auto& b : bible) {
-        int dist = levenshtein(toLower(b["book"]), toLower(input));
-        if (dist < bestDist) {
-            bestDist = dist;
-            bestBook = b["book"];
-        }
+// Remove a "--flag" that takes no value from argv; false if absent
+bool takeSwitch(int& argc, char* argv[], const string& flag) {
+    for (int i = 1; i < argc; i++) {
+        if (argv[i] != flag) continue;
+        for (int j = i; j + 1 < argc; j++) argv[j] = argv[j+1];
+        argv[--argc] = nullptr;
+        return true;
     }
-    if (bestDist <= 2) return bestBook; // fuzzy match threshold
-    return input; // fallback if no match
+    return false;
 }
 
-
-// --- Whole chapter helper ---
-void runChapter(json& bible, const string& book, int chapter) {
-    // Step 1: find closest book
-    string bestBook;
-    int bestDist = 999;
-    for (auto& b : bible) {
-        int dist = levenshtein(toLower(b["book"]), toLower(book));
-        if (dist < bestDist) {
-            bestDist = dist;
-            bestBook = b["book"];
-        }
-    }
-
-    // Step 2: check threshold
-    if (bestDist > 2) {
-        cerr << "Book not found.\n";
+// --- List all books from JSON ---
+void runListBooksColumn(const string& filename, OutputWriter& out) {
+    vector<string> books;
+    string error;
+    if (!readStringArray(filename, books, error)) {
+        out.err() << (error.empty() ? "Could not open books JSON file.\n" : "Invalid books JSON file: " + error + "\n");
         return;
     }
 
-    // Step 3: suggest if fuzzy
-    if (toLower(bestBook) != toLower(book)) {
-        cerr << "Did you mean '" << bestBook << "'?\n";
-    }
+    int cols = 4; // number of columns
+    int width = 20; // column width for alignment
+    int count = books.size();
 
-    // Step 4: search only in bestBook
-    bool found = false;
-    for (auto& b : bible) {
-        if (b["book"] == bestBook) {
-            for (auto& ch : b["chapters"]) {
-                if (ch["chapter"] == chapter) {
-                    for (auto& v : ch["verses"]) {
-                        cout << "\033[1;34m" << bestBook << "\033[0m" << "\033[32m" << chapter << ":" << v["verse"]
-                        << "\033[0m" << " → " << v["text"] << "\n";
-                        found = true;
-                    }
-                }
-            }
-        }
+    ostringstream list;
+    list << "NABRE BOOKS\n";
+    list << string(cols * width, '-') << "\n"; // underline
+
+    for (int i = 0; i < count; i++) {
+        list << left << setw(width) << books[i];
+        if ((i+1) % cols == 0) list << "\n";
     }
-    if (!found) cerr << "Chapter not found.\n";
+    if (count % cols != 0) list << "\n"; // final newline
+    out.append(list.str());
+    out.flush();
 }
 
-void runRange(json& bible, const string& book, int chapter, const string& verseArg) {
-    // Step 1: find closest book
-    string bestBook;
-    int bestDist = 999;
-    for (auto& b : bible) {
-        int dist = levenshtein(toLower(b["book"]), toLower(book));
-        if (dist < bestDist) {
-            bestDist = dist;
-            bestBook = b["book"];
-        }
-    }
+// Resident set size of this process, 0 where it cannot be read
+size_t residentBytes() {
+#ifdef __linux__
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) return resident * size_t(sysconf(_SC_PAGESIZE));
+#endif
+    return 0;
+}
 
-    // Step 2: check threshold
-    if (bestDist > 2) {
-        cerr << "Book not found.\n";
-        return;
+// --- Memory report: the corpus tables, the process RSS and, for
+// comparison, what the nlohmann DOM of nabre.json used to cost ---
+void runMemoryReport(const Corpus& bible, ostream& out) {
+    auto mb = [](double bytes) {
+        char buf[32];
+        snprintf(buf, sizeof buf, "%8.2f MB", bytes / 1048576.0);
+        return string(buf);
+    };
+    Corpus::Footprint f = bible.footprint();
+    const char* source = bible.compressed() ? "compressed, nabre.nbz"
+                         : bible.mapped() ? "mapped from nabre.bin" : "built from nabre.json";
+    out << "Corpus (" << source << "): "
+    << bible.bookCount() << " books, " << bible.chapterCount() << " chapters, " << bible.verseCount() << " verses\n";
+    if (bible.compressed()) {
+        char line[96];
+        snprintf(line, sizeof line, "  file            %s, %.2f MB of text inflated\n", mb(bible.fileSize()).c_str(),
+                 bible.textSize() / 1048576.0);
+        out << line << "  chapters read   " << bible.residentChapters() << " of " << bible.chapterCount() << "\n";
     }
-
-    // Step 3: suggest if fuzzy
-    if (toLower(bestBook) != toLower(book)) {
-        cerr << "Did you mean '" << bestBook << "'?\n";
+    out << "  text arena      " << mb(f.text) << "\n"
+    << "  verse records   " << mb(f.verses) << "\n"
+    << "  chapter records " << mb(f.chapters) << "\n"
+    << "  book records    " << mb(f.books) << "\n"
+    << "  total           " << mb(f.total()) << "\n";
+
+    size_t before = residentBytes();
+    if (before == 0) {
+        out << "Process RSS: not available on this platform\n";
+        return;
     }
-
-    // Step 4: parse verse range
-    int startVerse, endVerse;
-    if (verseArg.find('-') != string::npos) {
-        stringstream ss(verseArg);
-        string start, end;
-        getline(ss, start, '-');
-        getline(ss, end, '-');
-        startVerse = safeStoi(start);
-        endVerse   = safeStoi(end);
-        if (startVerse == -1 || endVerse == -1) return; // invalid input
-
-    } else {
-        startVerse = endVerse = safeStoi(verseArg);
-        if (startVerse == -1) return; // invalid input
-
-    }
-
-    // Step 5: search only inside bestBook
-    bool found = false;
-    for (auto& b : bible) {
-        if (b["book"] == bestBook) {
-            for (auto& ch : b["chapters"]) {
-                if (ch["chapter"] == chapter) {
-                    for (auto& v : ch["verses"]) {
-                        int verseNum = v["verse"];
-
-                        if (verseNum >= startVerse && verseNum <= endVerse) {
-                            cout << "\033[1;34m" << bestBook << " " << "\033[32m" << chapter << ":" << verseNum
-                            << "\033[0m" << " → " << v["text"] << "\n";
-                            found = true;
-                        }
-                    }
-                }
-            }
+    out << "Process RSS       " << mb(before) << "\n";
+
+    const string dataDir = NABRETERM_DATADIR;
+    for (const string& path : { string("nabre.json"), dataDir + "/nabre.json" }) {
+        ifstream file(path);
+        if (!file.is_open()) continue;
+        size_t domBytes = 0;
+        try {
+            nlohmann::json dom;
+            file >> dom;
+            size_t after = residentBytes();
+            domBytes = after > before ? after - before : 0;
+        } catch (const exception&) {
+            break;
+        }
+        char line[64];
+        snprintf(line, sizeof line, "+%.2f MB RSS", domBytes / 1048576.0);
+        out << "nlohmann DOM of " << path << ": " << line;
+        if (f.total() > 0) {
+            char ratio[32];
+            snprintf(ratio, sizeof ratio, " (%.1fx the corpus tables)", double(domBytes) / f.total());
+            out << ratio;
         }
+        out << "\n";
+        return;
     }
-
-    if (!found) cerr << "Verse(s) not found.\n";
+    out << "nlohmann DOM: no nabre.json to compare with\n";
 }
 
-
-
-// --- List all books from JSON ---
-void runListBooksColumn(const string& filename) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Could not open books JSON file.\n";
+void printCacheCounters(const QueryCache<CachedEvaluation>::Counters& c, ostream& out) {
+    if (c.budget == 0) {
+        out << "Search cache: off\n";
         return;
     }
-    json books;
-    file >> books;
-
-    int cols = 4; // number of columns
-    int width = 20; // column width for alignment
-    int count = books.size();
-
-    cout << "NABRE BOOKS\n";
-    cout << string(cols * width, '-') << "\n"; // underline
-
-    for (int i = 0; i < count; i++) {
-        cout << left << setw(width) << books[i].get<string>();
-        if ((i+1) % cols == 0) cout << "\n";
-    }
-    if (count % cols != 0) cout << "\n"; // final newline
+    char line[160];
+    snprintf(line, sizeof line, "Search cache: %zu entries, %.1f of %zu MB, %llu hits, %llu narrowed, %llu misses\n",
+             c.entries, c.bytes / 1048576.0, c.budget >> 20, (unsigned long long)c.hits,
+             (unsigned long long)c.supersetHits, (unsigned long long)c.misses);
+    out << line;
 }
 
-void replLoop(json& bible) {
+void replLoop(const Corpus& bible, const ReferenceIndex& refs, SearchIndex& index, ThreadPool& pool,
+              VerseSampler& sampler, SearchOptions& options, OutputWriter& out) {
     string histFile = string(getenv("HOME")) + "/.nabreterm_history";
 
     // Load history at startup (safe if file missing)
     read_history(histFile.c_str());
 
+    // The last search, for "more"
+    string lastQuery, lastScope;
+
     while (true) {
         char* input = readline("\033[1;37mNabreterm> \033[0m");
         if (!input) break; // Ctrl+D
@@ -475,7 +240,7 @@ void replLoop(json& bible) {
 
         if (line == "quit" || line == "exit") break;
         if (line == "list") {
-            runListBooksColumn("books.json");
+            runListBooksColumn("books.json", out);
             continue;
         }
 
@@ -496,6 +261,16 @@ void replLoop(json& bible) {
             << "  search faith && hope     → Operator search (AND)\n"
             << "  search faith || love     → Operator search (OR)\n"
             << "  search !(sin)            → Operator search (NOT)\n"
+            << "  search \"kingdom of heaven\" → Phrase search (whole words, in order)\n"
+            << "  search faith NEAR/3 hope → Words at most 3 words apart\n"
+            << "  crossverse [on|off]      → Let phrases and NEAR span verses of a chapter\n"
+            << "  ranked [on|off]          → Best matches first (BM25) instead of Bible order\n"
+            << "  page [N]                 → Show/set matches per page (0 = all)\n"
+            << "  more                     → Next page of the last search\n"
+            << "  fuzzy [N]                → Show/set max edits for fuzzy search (0 = off)\n"
+            << "  stats [on|off|reset]     → Show timings and counters (collected while on)\n"
+            << "  cache [MB|clear]         → Show/size the search result cache (0 = off)\n"
+            << "  memory                   → Corpus and process memory, vs. the old JSON DOM\n"
             << "  list                     → List all books\n"
             << "  random                   → random Bible Verse\n"
             << "  random [scope,e.g Psalms]→ random Bible Verse but its in the picked scope\n"
@@ -508,7 +283,10 @@ void replLoop(json& bible) {
         // Global search
         if (tokens[0] == "search" && tokens.size() >= 2) {
             string query = line.substr(7); // everything after "search "
-            searchEngine(bible, query);
+            lastQuery = query;
+            lastScope.clear();
+            options.offset = 0;
+            searchEngine(bible, index, pool, options, out, query);
             continue;
         }
 
@@ -519,100 +297,131 @@ void replLoop(json& bible) {
                 if (i > 2) keywordArg += " ";
                 keywordArg += tokens[i];
             }
-            searchEngine(bible, keywordArg, tokens[0]);
+            lastQuery = keywordArg;
+            lastScope = tokens[0];
+            options.offset = 0;
+            searchEngine(bible, index, pool, options, out, keywordArg, tokens[0]);
             continue;
         }
 
-        //Clear Screen
-        if (line == "clear") {
-            clearScreen();
+        // Next page of the last search
+        if (line == "more") {
+            if (lastQuery.empty() || options.limit == 0) {
+                cerr << "Nothing to page (set a page size with 'page N', then search).\n";
+                continue;
+            }
+            options.offset += options.limit;
+            searchEngine(bible, index, pool, options, out, lastQuery, lastScope);
             continue;
         }
 
-        // Random verse(s) with optional count and scope
-        if (tokens[0] == "random") {
-            int verseCount = 1; // default
-            string scopeArg;
-
-            // detect if second token is a number
-            if (tokens.size() >= 2) {
-                if (isdigit(tokens[1][0])) {
-                    verseCount = safeStoi(tokens[1]);
-                    if (tokens.size() >= 3) scopeArg = toLower(tokens[2]);
-                } else {
-                    scopeArg = toLower(tokens[1]);
-                }
+        // Results per page
+        if (tokens[0] == "page" && tokens.size() <= 2) {
+            if (tokens.size() == 2) {
+                int size = safeStoi(tokens[1]);
+                if (size < 0) continue;
+                options.limit = size;
+                options.offset = 0;
             }
+            cout << "Page size: " << (options.limit > 0 ? to_string(options.limit) + " matches" : "off") << "\n";
+            continue;
+        }
 
-            if (verseCount <= 0) {
-                cerr << "Invalid verse count.\n";
-                continue;
+        // BM25 relevance order
+        if (tokens[0] == "ranked" && tokens.size() <= 2) {
+            if (tokens.size() == 2) {
+                if (tokens[1] != "on" && tokens[1] != "off") {
+                    cerr << "Usage: ranked [on|off]\n";
+                    continue;
+                }
+                options.ranked = tokens[1] == "on";
             }
+            cout << "Ranked search: " << (options.ranked ? "on" : "off") << "\n";
+            continue;
+        }
 
-            vector<json> scope;
-            if (!scopeArg.empty()) {
-                if (scopeArg == "ot") {
-                    for (auto& b : bible) if (!isNewTestament(b["book"])) scope.push_back(b);
-                } else if (scopeArg == "nt") {
-                    for (auto& b : bible) if (isNewTestament(b["book"])) scope.push_back(b);
-                } else if (scopeArg == "deut") {
-                    for (auto& b : bible) if (isDeuterocanonical(b["book"])) scope.push_back(b);
-                } else {
-                    // fuzzy match for specific book
-                    string bestBook;
-                    int bestDist = 999;
-                    for (auto& b : bible) {
-                        int dist = levenshtein(toLower(b["book"]), scopeArg);
-                        if (dist < bestDist) { bestDist = dist; bestBook = b["book"]; }
-                    }
-                    if (bestDist <= 2) {
-                        for (auto& b : bible) if (b["book"] == bestBook) { scope.push_back(b); break; }
-                    }
-                }
-            } else {
-                scope = bible; // default whole Bible
+        // Fuzzy search threshold
+        if (tokens[0] == "fuzzy" && tokens.size() <= 2) {
+            if (tokens.size() == 2) {
+                int distance = safeStoi(tokens[1]);
+                if (distance < 0) continue;
+                options.fuzzyDistance = distance;
             }
+            cout << "Fuzzy search: " << (options.fuzzyDistance > 0
+            ? "up to " + to_string(options.fuzzyDistance) + " edits" : "off") << "\n";
+            continue;
+        }
 
-            if (scope.empty()) {
-                cerr << "Scope not found.\n";
-                continue;
+        // Phrases and NEAR across verse boundaries
+        if (tokens[0] == "crossverse" && tokens.size() <= 2) {
+            if (tokens.size() == 2) {
+                if (tokens[1] != "on" && tokens[1] != "off") {
+                    cerr << "Usage: crossverse [on|off]\n";
+                    continue;
+                }
+                options.crossVerse = tokens[1] == "on";
             }
+            cout << "Cross-verse phrases: " << (options.crossVerse ? "on" : "off") << "\n";
+            continue;
+        }
 
-            // pick random book + chapter
-            int bIndex = rand() % scope.size();
-            auto& b = scope[bIndex];
-            int cIndex = rand() % b["chapters"].size();
-            auto& ch = b["chapters"][cIndex];
+        if (line == "memory") {
+            runMemoryReport(bible, cout);
+            continue;
+        }
 
-            if (ch["verses"].size() < static_cast<size_t>(verseCount)) {
-                cerr << "Not enough verses in this chapter.\n";
+        // Query result cache
+        if (tokens[0] == "cache" && tokens.size() <= 2) {
+            string arg = tokens.size() == 2 ? tokens[1] : "";
+            if (arg == "clear") {
+                index.cache().clear();
                 continue;
             }
-
-            // pick distinct verses
-            vector<int> chosen;
-            while (chosen.size() < static_cast<size_t>(verseCount)) {
-                int vIndex = rand() % ch["verses"].size();
-                if (find(chosen.begin(), chosen.end(), vIndex) == chosen.end()) {
-                    chosen.push_back(vIndex);
-                }
+            if (!arg.empty()) {
+                int megabytes = safeStoi(arg);
+                if (megabytes < 0) continue;
+                index.cache().setBudget(size_t(megabytes) << 20);
             }
+            printCacheCounters(index.cache().counters(), cout);
+            continue;
+        }
 
-            for (int idx : chosen) {
-                auto& v = ch["verses"][idx];
-                cout << "\033[1;34m" << b["book"] << " "
-                << "\033[32m" << ch["chapter"] << ":" << v["verse"]
-                << "\033[0m → " << v["text"] << "\n";
+        // Phase timings and counters
+        if (tokens[0] == "stats" && tokens.size() <= 2) {
+            string arg = tokens.size() == 2 ? tokens[1] : "";
+            if (arg == "on" || arg == "off") {
+                enableStats(arg == "on");
+                cout << "Stats: " << arg << "\n";
+            } else if (arg == "reset") {
+                resetStats();
+            } else if (!arg.empty()) {
+                cerr << "Usage: stats [on|off|reset]\n";
+            } else if (!statsEnabled()) {
+                cout << "Stats are off (turn them on with 'stats on' or --stats).\n";
+            } else {
+                reportStats(cout);
             }
             continue;
         }
 
+        //Clear Screen
+        if (line == "clear") {
+            clearScreen();
+            continue;
+        }
+
+        // Random verse(s) with optional count and scope
+        if (tokens[0] == "random") {
+            runRandom(bible, refs, sampler, out, tokens);
+            continue;
+        }
+
         // Book + Chapter only
 else if (tokens.size() == 2) {
     int chapter = safeStoi(tokens[1]);
     if (chapter == -1) continue;
-    string book = resolveBook(bible, tokens[0]);
-    runChapter(bible, book, chapter);
+    string book = resolveBook(bible, refs, tokens[0]);
+    runChapter(bible, refs, out, book, chapter);
     continue;
 }
 
@@ -620,8 +429,8 @@ else if (tokens.size() == 2) {
 else if (tokens.size() == 3) {
     int chapter = safeStoi(tokens[1]);
     if (chapter == -1) continue;
-    string book = resolveBook(bible, tokens[0]);
-    runRange(bible, book, chapter, tokens[2]);
+    string book = resolveBook(bible, refs, tokens[0]);
+    runRange(bible, refs, out, book, chapter, tokens[2]);
     continue;
 }
 
@@ -636,25 +445,111 @@ else if (tokens.size() == 3) {
     write_history(histFile.c_str());
 }
 
-int main(int argc, char* argv[]) {
-    auto args = parseArgs(argc, argv);
+// --- Compile nabre.json into the binary corpus: nabreterm compile <in.json> [-o out.bin] ---
+int runCompile(int argc, char* argv[]) {
+    string input, output;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-o" && i+1 < argc) output = argv[++i];
+        else input = arg;
+    }
+    if (input.empty()) {
+        cerr << "Usage: nabreterm compile <nabre.json> [-o nabre.bin | -o nabre.nbz]\n";
+        return 1;
+    }
+    if (output.empty()) {
+        size_t dot = input.rfind('.');
+        output = (dot == string::npos ? input : input.substr(0, dot)) + ".bin";
+    }
 
-    ifstream file("nabre.json");
-    if (!file.is_open()) {
-        file.open(std::string(NABRETERM_DATADIR) + "/nabre.json");
+    Corpus corpus;
+    vector<JsonSpan> spans;
+    if (!corpus.loadJson(input, &spans)) {
+        cerr << "Could not read " << input << "\n";
+        return 1;
     }
-    if (!file.is_open()) {
-        std::cerr << "Could not open NABRE JSON file.\n";
+    // A .nbz output is the block-compressed corpus. Both record the JSON's
+    // stamp, so that a later edit of the JSON is noticed.
+    bool compressed = output.size() > 4 && output.compare(output.size() - 4, 4, ".nbz") == 0;
+    JsonStamp source;
+    stampOf(input, source);
+    if (!(compressed ? corpus.writeCompressed(output, source) : corpus.writeBinary(output, source))) {
+        cerr << "Could not write " << output << "\n";
         return 1;
     }
+    // Lets lookups against the JSON alone skip the other books
+    if (!writeBookIndex(input, corpus, spans)) {
+        cerr << "Could not write " << bookIndexPath(input) << "\n";
+    }
+    cout << "Compiled " << corpus.bookCount() << " books, " << corpus.chapterCount()
+    << " chapters, " << corpus.verseCount() << " verses → " << output << "\n";
+    return 0;
+}
 
-    json bible;
-    file >> bible;
+// Book of a one-shot reference lookup (`<Book> <chapter> [verses]`), or ""
+// for the commands that need the whole corpus
+string referenceBook(int argc, char* argv[]) {
+    if (argc < 3 || argc > 4 || string(argv[1]) == "search" || string(argv[2]) == "search") return "";
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]).rfind("--", 0) == 0) return "";
+    }
+    return argv[1];
+}
+
+// Per-command options, accepted anywhere on the command line
+struct CommandOptions {
+    SearchOptions search;
+    OutputFormat format = OutputFormat::Text;
+    bool color = false;
+};
+
+// Take --fuzzy, --cross-verse, --ranked, --limit, --offset, --format and
+// --color out of argv. tty decides the default color; false (after
+// printing why) on a bad value.
+bool parseCommandOptions(int& argc, char* argv[], bool tty, CommandOptions& options, ostream& err) {
+    string fuzzyArg = takeOption(argc, argv, "--fuzzy");
+    if (!fuzzyArg.empty()) {
+        options.search.fuzzyDistance = safeStoi(fuzzyArg, err);
+        if (options.search.fuzzyDistance < 0) return false;
+    }
+    options.search.crossVerse = takeSwitch(argc, argv, "--cross-verse");
+    options.search.ranked = takeSwitch(argc, argv, "--ranked");
+    for (auto [flag, value] : { pair{ "--limit", &options.search.limit }, pair{ "--offset", &options.search.offset } }) {
+        string arg = takeOption(argc, argv, flag);
+        if (arg.empty()) continue;
+        int n = safeStoi(arg, err);
+        if (n < 0) return false;
+        *value = n;
+    }
+
+    string formatArg = takeOption(argc, argv, "--format");
+    if (!formatArg.empty() && !parseOutputFormat(formatArg, options.format)) {
+        err << "Unknown format: " << formatArg << " (use text, plain, ndjson or tsv)\n";
+        return false;
+    }
+
+    // Color only when a terminal is watching, unless asked otherwise
+    options.color = tty;
+    string colorArg = takeOption(argc, argv, "--color");
+    if (colorArg == "always") options.color = true;
+    else if (colorArg == "never") options.color = false;
+    else if (!colorArg.empty() && colorArg != "auto") {
+        err << "Unknown color mode: " << colorArg << " (use auto, always or never)\n";
+        return false;
+    }
+    return true;
+}
+
+// One-shot command (search, chapter, range, list) from argv with the
+// options already taken out. Shared by direct runs and the daemon.
+int runCommand(int argc, char* argv[], const Corpus& bible, const ReferenceIndex& refs, SearchIndex& index,
+               ThreadPool& pool, const CommandOptions& options, OutputWriter& out) {
+    auto args = parseArgs(argc, argv);
 
     // --- Flag-based search ---
     if (args.count("--search")) {
         string query = args["--search"];
-        searchEngine(bible, query);
+        searchEngine(bible, index, pool, options.search, out, query);
         return 0;
     }
 
@@ -666,36 +561,358 @@ int main(int argc, char* argv[]) {
             if (i > 3) keywordArg += " ";
             keywordArg += argv[i];
         }
-        searchEngine(bible, keywordArg, book);
+        searchEngine(bible, index, pool, options.search, out, keywordArg, book);
         return 0;
     }
 
     // --- Positional arguments fallback ---
     if (argc >= 3) {
         if (string(argv[1]) == "search" && argc == 3) {
-            searchEngine(bible, argv[2]);
+            searchEngine(bible, index, pool, options.search, out, argv[2]);
         } else {
             string book = argv[1];
-            int chapter = safeStoi(argv[2]);
+            int chapter = safeStoi(argv[2], out.err());
             if (chapter == -1) return 1;
             if (argc == 3) {
-                runChapter(bible, book, chapter);
+                runChapter(bible, refs, out, book, chapter);
             } else {
-                runRange(bible, book, chapter, argv[3]);
+                runRange(bible, refs, out, book, chapter, argv[3]);
             }
         }
     }
 
     // --- List all books ---
     if (args.count("--list") || (argc == 2 && string(argv[1]) == "list")) {
-        runListBooksColumn("books.json");
+        runListBooksColumn("books.json", out);
+        return 0;
+    }
+    return 0;
+}
+
+// --- Batch mode: nabreterm --batch [file] ---
+// "John 3:16-18; Rom 8:28; 9:1": books may be abbreviated, and a citation
+// without a book continues with the previous one
+void runCitations(const Corpus& bible, const ReferenceIndex& refs, OutputWriter& out, const string& line) {
+    string book;
+    stringstream list(line);
+    for (string citation; getline(list, citation, ';');) {
+        istringstream iss(citation);
+        vector<string> parts;
+        for (string w; iss >> w;) parts.push_back(w);
+        if (parts.empty()) continue;
+
+        string spec = parts.back();
+        parts.pop_back();
+        if (!parts.empty()) {
+            string name;
+            for (auto& part : parts) name += part;
+            uint32_t bi = refs.resolveAbbreviation(bible, name);
+            book = bi == ReferenceIndex::NO_BOOK ? name : string(bible.bookName(bi));
+        }
+        if (book.empty()) {
+            out.err() << "Missing book name: " << citation << "\n";
+            continue;
+        }
+
+        size_t colon = spec.find(':');
+        int chapter = safeStoi(spec.substr(0, colon), out.err());
+        if (chapter == -1) continue;
+        if (colon == string::npos) runChapter(bible, refs, out, book, chapter);
+        else runRange(bible, refs, out, book, chapter, spec.substr(colon + 1));
+    }
+}
+
+// One batch line: the REPL's reference and search commands, or citations.
+// Searches call buildIndex() first.
+void runBatchLine(const string& line, const Corpus& bible, const ReferenceIndex& refs, SearchIndex& index,
+                  ThreadPool& pool, const SearchOptions& options, OutputWriter& out,
+                  const function<void()>& buildIndex) {
+    istringstream iss(line);
+    vector<string> tokens;
+    for (string w; iss >> w;) tokens.push_back(w);
+
+    if (tokens[0] == "search" && tokens.size() >= 2) {
+        buildIndex();
+        searchEngine(bible, index, pool, options, out, line.substr(7));
+    } else if (tokens.size() >= 3 && tokens[1] == "search") {
+        string keywordArg;
+        for (size_t i = 2; i < tokens.size(); i++) {
+            if (i > 2) keywordArg += " ";
+            keywordArg += tokens[i];
+        }
+        buildIndex();
+        searchEngine(bible, index, pool, options, out, keywordArg, tokens[0]);
+    } else if (line.find_first_of(":;") != string::npos) {
+        runCitations(bible, refs, out, line);
+    } else if (tokens.size() == 2 || tokens.size() == 3) {
+        int chapter = safeStoi(tokens[1], out.err());
+        if (chapter == -1) return;
+        string book = resolveBook(bible, refs, tokens[0]);
+        if (tokens.size() == 2) runChapter(bible, refs, out, book, chapter);
+        else runRange(bible, refs, out, book, chapter, tokens[2]);
+    } else {
+        out.err() << "Unknown command: " << line << "\n";
+    }
+}
+
+// Delimiter written before each line's results
+void writeBatchHeader(OutputWriter& out, size_t number, const string& line) {
+    string& buf = out.buffer();
+    if (out.format() == OutputFormat::Ndjson) {
+        buf += "{\"line\":" + to_string(number) + ",\"query\":";
+        appendQuoted(buf, line);
+        buf += "}\n";
+    } else if (out.format() == OutputFormat::Tsv) {
+        buf += "#\t" + to_string(number) + "\t";
+        appendTsvField(buf, line);
+        buf += "\n";
+    } else {
+        buf += out.ansi("\033[1;37m") + ("==> " + line + " <==") + out.ansi("\033[0m") + "\n";
+    }
+}
+
+// Lines are read, parsed and run as pool tasks while earlier ones are still
+// in flight; each captures its own output, and finished lines are printed
+// strictly in input order. Blank lines and lines starting with # are skipped.
+int runBatch(istream& in, const Corpus& bible, const ReferenceIndex& refs, SearchIndex& index,
+             ThreadPool& pool, const CommandOptions& options) {
+    // Built by the first search line, once, as concurrent searches share it;
+    // a batch of lookups never builds it
+    once_flag indexOnce;
+    function<void()> buildIndex = [&] {
+        call_once(indexOnce, [&] {
+            if (!index.built()) index.build(bible);
+        });
+    };
+
+    struct Job {
+        size_t number;
+        string line;
+        CapturedOutput output;
+        bool done = false;
+    };
+    mutex doneMutex;
+    condition_variable doneChanged;
+    deque<unique_ptr<Job>> window;
+    const size_t maxInFlight = pool.concurrency() * 16;
+
+    // Print finished jobs from the front, waiting while more than keep
+    // are still queued
+    auto drain = [&](size_t keep) {
+        while (!window.empty()) {
+            Job& front = *window.front();
+            {
+                unique_lock<mutex> lock(doneMutex);
+                if (!front.done && window.size() <= keep) return;
+                doneChanged.wait(lock, [&] { return front.done; });
+            }
+            front.output.replay(cout, cerr);
+            window.pop_front();
+        }
+    };
+
+    string line;
+    for (size_t number = 1; getline(in, line); number++) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') continue;
+        size_t last = line.find_last_not_of(" \t\r");
+
+        window.push_back(make_unique<Job>());
+        Job* job = window.back().get();
+        job->number = number;
+        job->line = line.substr(first, last - first + 1);
+        pool.submit([&, job] {
+            {
+                OutputWriter out(options.format, options.color, job->output.out(), job->output.err(), 1 << 16);
+                writeBatchHeader(out, job->number, job->line);
+                out.flush();    // before any error the line prints
+                runBatchLine(job->line, bible, refs, index, pool, options.search, out, buildIndex);
+            }
+            // Notified under the lock: once the last job is seen done,
+            // runBatch() returns and doneChanged goes away
+            lock_guard<mutex> lock(doneMutex);
+            job->done = true;
+            doneChanged.notify_all();
+        });
+        drain(maxInFlight - 1);
+    }
+    drain(0);
+    return 0;
+}
+
+// The data files a command run from here could read, one per line as
+// "<size> <mtime> <absolute path>": every corpus file in the order they are
+// tried, then books.json. Two processes that agree on these load the same
+// text, so the daemon answers only the clients whose list matches its own.
+string dataFilesHere() {
+    vector<string> paths;
+    for (const string& dir : corpusDirs()) {
+        for (const char* file : { "nabre.bin", "nabre.nbz", "nabre.json" }) paths.push_back(dir + "/" + file);
+    }
+    paths.push_back("books.json");
+
+    string files;
+    for (const string& path : paths) {
+        JsonStamp stamp;
+        error_code ec;
+        const filesystem::path absolute = filesystem::absolute(path, ec);
+        if (ec || !stampOf(path, stamp)) continue;
+        files += to_string(stamp.size) + " " + to_string(stamp.mtime) + " " + absolute.lexically_normal().string() + "\n";
+    }
+    return files;
+}
+
+// --- Daemon: nabreterm --serve [socket] ---
+// Everything is loaded and indexed up front, then each request runs
+// runCommand() on a client thread against the shared, read-only state.
+int runServer(const string& socketPath, unsigned threads, size_t cacheBytes) {
+    if (socketPath.empty()) {
+        cerr << "No usable socket path: set NABRETERM_SOCKET or pass --serve a path.\n";
+        return 1;
+    }
+    const string dataFiles = dataFilesHere();   // before loading: a later change is then a mismatch
+    Corpus bible;
+    if (!loadCorpus(bible)) return 1;
+    ReferenceIndex refs;
+    refs.build(bible);
+    SearchIndex index;
+    index.build(bible);
+    index.cache().setBudget(cacheBytes);
+    ThreadPool pool(threads - 1);
+
+    // Clients beyond the threads would only contend for the pool
+    return serveSocket(socketPath, dataFiles, max(4u, threads),
+                       [&](vector<string>& request, bool tty, ostream& outStream, ostream& errStream) {
+        vector<char*> argv = { const_cast<char*>("nabreterm") };
+        for (string& arg : request) argv.push_back(&arg[0]);
+        argv.push_back(nullptr);
+        int argc = argv.size() - 1;
+
+        takeOption(argc, argv.data(), "--threads");   // the daemon's pool is fixed
+        takeOption(argc, argv.data(), "--seed");      // only `random` uses it, in the REPL
+        takeOption(argc, argv.data(), "--cache-mb");  // and its cache
+        CommandOptions options;
+        if (!parseCommandOptions(argc, argv.data(), tty, options, errStream)) return 1;
+        if (argc == 1) {
+            errStream << "The REPL cannot run through the daemon.\n";
+            return 1;
+        }
+        OutputWriter out(options.format, options.color, outStream, errStream);
+        return runCommand(argc, argv.data(), bible, refs, index, pool, options, out);
+    });
+}
+
+// Built without main() when another program (bench/nabreterm_bench.cpp)
+// includes this file to drive the commands directly
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && string(argv[1]) == "compile") {
+        return runCompile(argc, argv);
+    }
+    if (argc == 2 && string(argv[1]) == "memory") {
+        Corpus bible;
+        if (!loadCorpus(bible)) return 1;
+        runMemoryReport(bible, cout);
         return 0;
     }
+    vector<string> request(argv + 1, argv + argc);   // as typed, for the daemon
+
+    string serveArg;
+    bool serve = takeFlag(argc, argv, "--serve", serveArg);
+    string batchPath;
+    bool batch = takeFlag(argc, argv, "--batch", batchPath);
+    bool stats = takeSwitch(argc, argv, "--stats");
+    enableStats(stats);
+
+    // Fixed seed for `random`, so a session can be replayed
+    string seedArg = takeOption(argc, argv, "--seed");
+    uint64_t seed = random_device{}();
+    if (!seedArg.empty()) {
+        try {
+            size_t used = 0;
+            seed = stoull(seedArg, &used);
+            if (used != seedArg.size()) throw invalid_argument(seedArg);
+        } catch (...) {
+            cerr << "Invalid seed: " << seedArg << "\n";
+            return 1;
+        }
+    }
+
+    unsigned threads = ThreadPool::defaultThreads();
+    string threadsArg = takeOption(argc, argv, "--threads");
+    if (!threadsArg.empty()) {
+        int n = safeStoi(threadsArg);
+        if (n < 1) {
+            if (n == 0) cerr << "Invalid thread count: " << threadsArg << "\n";
+            return 1;
+        }
+        threads = n;
+    }
+
+    // Memory for repeated searches (REPL, batch, daemon)
+    size_t cacheBytes = QueryCache<CachedEvaluation>::DEFAULT_BUDGET;
+    string cacheArg = takeOption(argc, argv, "--cache-mb");
+    if (!cacheArg.empty()) {
+        int megabytes = safeStoi(cacheArg);
+        if (megabytes < 0) return 1;
+        cacheBytes = size_t(megabytes) << 20;
+    }
+
+    CommandOptions options;
+    if (!parseCommandOptions(argc, argv, stdoutIsTerminal(), options, cerr)) return 1;
+
+    if (serve) return runServer(serveArg.empty() ? defaultSocketPath(true) : serveArg, threads, cacheBytes);
+
+    // One-shot commands go to a running daemon when there is one that
+    // loaded the same data files (not with --stats, which measures this
+    // process)
+    int status = 0;
+    if (argc > 1 && !batch && !stats
+        && forwardToDaemon(defaultSocketPath(), dataFilesHere(), request, stdoutIsTerminal(), status)) {
+        return status;
+    }
+
+    // A reference lookup only reads its own book when there is no nabre.bin
+    Corpus bible;
+    ReferenceIndex refs;
+    {
+        ScopedTimer timer(StatPhase::Load);
+        const string book = batch ? "" : referenceBook(argc, argv);
+        if (!(book.empty() ? loadCorpus(bible) : loadCorpusForBook(bible, book))) return 1;
+        refs.build(bible);
+    }
+    SearchIndex index;
+    index.cache().setBudget(cacheBytes);
+    ThreadPool pool(threads - 1); // the calling thread works too
+
+    // --- Batch mode: one command per line from a file or stdin ---
+    if (batch) {
+        if (batchPath.empty() || batchPath == "-") {
+            status = runBatch(cin, bible, refs, index, pool, options);
+        } else {
+            ifstream file(batchPath);
+            if (!file.is_open()) {
+                cerr << "Could not open " << batchPath << "\n";
+                return 1;
+            }
+            status = runBatch(file, bible, refs, index, pool, options);
+        }
+        if (stats) reportStats(cerr);
+        return status;
+    }
+
+    OutputWriter out(options.format, options.color);
 
     // --- Interactive REPL mode ---
     if (argc == 1) {
-        replLoop(bible);
+        VerseSampler sampler(seed);
+        sampler.build(bible);
+        addRandomScopes(bible, sampler);
+        replLoop(bible, refs, index, pool, sampler, options.search, out);
+        return 0;
     }
 
-    return 0;
+    status = runCommand(argc, argv, bible, refs, index, pool, options, out);
+    out.flush();
+    if (stats) reportStats(cerr);
+    return status;
 }
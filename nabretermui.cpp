@@ -3,7 +3,7 @@
 #include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/screen.hpp>
-#include <nlohmann/json.hpp>
+#include <ftxui/screen/terminal.hpp>
 
 #include <iostream>
 #include <fstream>
@@ -11,26 +11,28 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <cctype>
 #include <random>
-#include <thread>
 #include <atomic>
+#include <condition_variable>
 #include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
-#ifndef NABRETERM_DATADIR
-#define NABRETERM_DATADIR "."
-#endif
+#include "corpus.hpp"
+#include "highlighter.hpp"
+#include "query_cache.hpp"
+#include "text_scan.hpp"
+#include "thread_pool.hpp"
+#include "verse_sampler.hpp"
 
 using namespace ftxui;
-using json = nlohmann::json;
-
-// --- Global state for async results ---
-std::atomic<bool> has_new_results{false};
-std::vector<std::string> new_results;
-
 
-//Clipboard
-static void copyToClipboard(const std::string& text) {
+//Clipboard: false if no clipboard tool could be run
+static bool copyToClipboard(const std::string& text) {
   FILE* pipe = nullptr;
 
 #ifdef _WIN32
@@ -38,7 +40,7 @@ static void copyToClipboard(const std::string& text) {
   if (pipe) {
     fwrite(text.c_str(), sizeof(char), text.size(), pipe);
     _pclose(pipe);
-    return;
+    return true;
   }
 #else
   // macOS
@@ -46,7 +48,7 @@ static void copyToClipboard(const std::string& text) {
   if (pipe) {
     fwrite(text.c_str(), sizeof(char), text.size(), pipe);
     pclose(pipe);
-    return;
+    return true;
   }
 
   // Linux X11: xclip
@@ -54,7 +56,7 @@ static void copyToClipboard(const std::string& text) {
   if (pipe) {
     fwrite(text.c_str(), sizeof(char), text.size(), pipe);
     pclose(pipe);
-    return;
+    return true;
   }
 
   // Linux X11: xsel
@@ -62,7 +64,7 @@ static void copyToClipboard(const std::string& text) {
   if (pipe) {
     fwrite(text.c_str(), sizeof(char), text.size(), pipe);
     pclose(pipe);
-    return;
+    return true;
   }
 
   // Wayland: wl-clipboard
@@ -70,107 +72,399 @@ static void copyToClipboard(const std::string& text) {
   if (pipe) {
     fwrite(text.c_str(), sizeof(char), text.size(), pipe);
     pclose(pipe);
-    return;
+    return true;
   }
 #endif
 
-  // If none worked, show feedback in results
-  new_results = { "Clipboard tool not found. Install xclip, xsel, or wl-clipboard." };
-  has_new_results = true;
+  return false;
 }
 
 
 
-// --- Utility functions ---
-static std::string toLower(const std::string& s) {
-  std::string result = s;
-  std::transform(result.begin(), result.end(), result.begin(),
-                 [](unsigned char c){ return std::tolower(c); });
-  return result;
+// Verses matching a search, in canonical order
+struct SearchResult {
+  std::vector<uint32_t> verses;
+
+  size_t bytes() const { return verses.capacity() * sizeof(uint32_t); }
+};
+
+// One row of the results window, with the byte ranges to highlight
+struct ResultLine {
+  std::string text;
+  std::vector<ByteRange> marks = {};   // merged
+};
+
+// "Book C:V → text" for one verse ID, so a page of results is formatted
+// without walking the corpus
+static std::string verseLine(const Corpus& bible, uint32_t vi) {
+  const uint32_t ci = bible.chapterOf(vi);
+  std::ostringstream oss;
+  writeQuoted(oss, bible.bookName(bible.bookOf(ci)));
+  oss << " " << bible.chapter(ci).number << ":" << bible.verse(vi).number
+      << " → " << bible.verseText(vi);
+  return oss.str();
 }
 
-static std::vector<std::string> searchEngine(json& bible, const std::string& query) {
-  std::vector<std::string> results;
-  std::string q = toLower(query);
-
-  for (auto& b : bible) {
-    for (auto& ch : b["chapters"]) {
-      for (auto& v : ch["verses"]) {
-        std::string text = v["text"];
-        if (!q.empty() && toLower(text).find(q) != std::string::npos) {
-          std::ostringstream oss;
-          oss << b["book"] << " " << ch["chapter"] << ":" << v["verse"]
-              << " → " << text;
-          results.push_back(oss.str());
+// Books are scanned in parallel (one shard per book, balanced by work
+// stealing) and the per-book results are concatenated in canonical order.
+// Only verse IDs are collected; lines are formatted a page at a time.
+// The scan runs over the pre-folded text, so verses are never copied or
+// lowercased per search; while that is still being built (folded is null)
+// each verse is folded as it is tested instead, with the same results.
+// With `within` (sorted verse IDs) only those verses are tested, which is
+// how an extended query refines a cached broader one. Returns false,
+// leaving result incomplete, once cancelled() says so.
+static bool searchEngine(const Corpus& bible, const FoldedText* folded, ThreadPool& pool,
+                         const std::string& needle, const std::vector<uint32_t>* within,
+                         const std::function<bool()>& cancelled, SearchResult& result) {
+  std::vector<SearchResult> shards(bible.bookCount());
+
+  pool.parallelFor(bible.bookCount(), 1, [&](size_t first, size_t last, size_t) {
+    FoldBuffer buffer;
+    auto contains = [&](uint32_t vi) {
+      if (folded) return folded->contains(vi, needle);
+      const FoldedView verse = foldInto(bible.verseText(vi), buffer);
+      return findFolded(verse.text.data(), verse.text.size(), needle) != SCAN_NOT_FOUND;
+    };
+
+    for (uint32_t bi = first; bi < last; bi++) {
+      const BookRecord& b = bible.book(bi);
+      if (b.chapterCount == 0 || cancelled()) continue;
+      const ChapterRecord& firstCh = bible.chapter(b.firstChapter);
+      const ChapterRecord& lastCh = bible.chapter(b.firstChapter + b.chapterCount - 1);
+      const uint32_t begin = firstCh.firstVerse, end = lastCh.firstVerse + lastCh.verseCount;
+
+      auto emit = [&](uint32_t vi) { shards[bi].verses.push_back(vi); };
+
+      if (!within && folded) {
+        folded->forEachMatch(needle, begin, end, emit);
+        continue;
+      }
+      if (!within) {
+        for (uint32_t vi = begin; vi < end; vi++) {
+          if (contains(vi)) emit(vi);
         }
+        continue;
+      }
+      auto it = std::lower_bound(within->begin(), within->end(), begin);
+      for (; it != within->end() && *it < end; ++it) {
+        if (contains(*it)) emit(*it);
       }
     }
+  });
+  if (cancelled()) return false;
+
+  for (auto& shard : shards) {
+    result.verses.insert(result.verses.end(), shard.verses.begin(), shard.verses.end());
   }
-  if (results.empty()) results.push_back("No matches found.");
-  return results;
+  return true;
 }
 
-static std::string randomVerse(json& bible) {
-  static std::mt19937 rng(std::random_device{}());
-  int bIndex = rng() % bible.size();
-  auto& b = bible[bIndex];
-  int cIndex = rng() % b["chapters"].size();
-  auto& ch = b["chapters"][cIndex];
-  int vIndex = rng() % ch["verses"].size();
-  auto& v = ch["verses"][vIndex];
+// --- Background warm-up ---
+// The folded text is built on a thread of its own, so the first frame does
+// not wait for it however large the corpus is. Until it is complete,
+// folded() is null and searches take the brute-force path; every search
+// started after that uses it. notify is called as the build progresses
+// (for the progress bar) and once it is done. Quitting before then cancels
+// the build rather than waiting for it.
+class BackgroundIndex {
+ public:
+  BackgroundIndex(const Corpus& bible, std::function<void()> notify)
+      : bible_(bible), notify_(std::move(notify)), thread_([this] { run(); }) {}
+
+  BackgroundIndex(const BackgroundIndex&) = delete;
+  BackgroundIndex& operator=(const BackgroundIndex&) = delete;
+
+  ~BackgroundIndex() {
+    cancel_.store(true, std::memory_order_relaxed);
+    thread_.join();
+  }
+
+  // The folded text once it is complete, else nullptr
+  const FoldedText* folded() const {
+    return ready_.load(std::memory_order_acquire) ? &folded_ : nullptr;
+  }
+
+  // Fraction of the verses folded so far
+  float progress() const {
+    if (ready_.load(std::memory_order_acquire)) return 1.0f;
+    const uint32_t total = bible_.verseCount();
+    return total ? float(done_.load(std::memory_order_relaxed)) / total : 0.0f;
+  }
+
+ private:
+  void run() {
+    const bool built = folded_.build(bible_, [this](uint32_t done) {
+      done_.store(done, std::memory_order_relaxed);
+      notify_();
+      return !cancel_.load(std::memory_order_relaxed);
+    });
+    if (!built) return;
+    ready_.store(true, std::memory_order_release);
+    notify_();
+  }
+
+  const Corpus& bible_;
+  std::function<void()> notify_;
+  FoldedText folded_;
+  std::atomic<uint32_t> done_{0};
+  std::atomic<bool> ready_{false};
+  std::atomic<bool> cancel_{false};
+
+  std::thread thread_;   // last, so it starts after everything above
+};
+
+// --- Live search ---
+// One long-lived worker runs the searches typed into the input box. Every
+// request bumps a generation counter: a running search checks it between
+// books and gives up as soon as a newer request supersedes it, and results
+// only reach the UI (through a mutex-guarded handoff) while they are still
+// the latest. Finished searches go to a QueryCache by needle: a repeated
+// needle is answered from it, and otherwise only the matches of the
+// smallest cached needle it contains are re-tested. Results are shown
+// PAGE_SIZE lines at a time; turning the page formats the next slice of
+// the same matches.
+class SearchWorker {
+ public:
+  static constexpr size_t PAGE_SIZE = 500;
+
+  SearchWorker(const Corpus& bible, const BackgroundIndex& index, ThreadPool& pool,
+               std::function<void()> notify)
+      : bible_(bible), index_(index), pool_(pool), notify_(std::move(notify)),
+        thread_([this] { run(); }) {}
+
+  SearchWorker(const SearchWorker&) = delete;
+  SearchWorker& operator=(const SearchWorker&) = delete;
+
+  ~SearchWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+      generation_++;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  // Search for query, superseding any search still running
+  void search(const std::string& query) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_ = query;
+      has_pending_ = true;
+      generation_++;
+    }
+    wake_.notify_one();
+  }
+
+  // Move delta pages through the current search results (ignored while
+  // something else is shown)
+  void turnPage(int delta) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!paged_) return;
+      page_turn_ += delta;
+    }
+    wake_.notify_one();
+  }
+
+  // Show lines right away (random verse, messages), superseding any search
+  void show(const std::vector<std::string>& lines) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      has_pending_ = false;
+      paged_ = false;
+      page_turn_ = 0;
+      generation_++;
+      ready_.clear();
+      for (const std::string& line : lines) ready_.push_back({ line });
+      has_ready_ = true;
+    }
+    notify_();
+  }
+
+  // UI thread: the latest results, if new ones arrived since the last call
+  bool take(std::vector<ResultLine>& lines) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_ready_) return false;
+    lines = std::move(ready_);
+    has_ready_ = false;
+    return true;
+  }
+
+ private:
+  void run() {
+    while (true) {
+      std::string needle;
+      uint64_t generation;
+      int turn = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stop_ || has_pending_ || page_turn_ != 0; });
+        if (stop_) return;
+        if (has_pending_) {
+          needle = foldText(pending_);
+          has_pending_ = false;
+        } else {
+          turn = page_turn_;
+        }
+        page_turn_ = 0;
+        generation = generation_;
+      }
+
+      if (turn != 0) {
+        const long pages = (last_verses_.size() + PAGE_SIZE - 1) / PAGE_SIZE;
+        page_ = std::clamp<long>(long(page_) + turn, 0, std::max(0L, pages - 1));
+        deliver(generation, pageLines());
+        continue;
+      }
+
+      std::function<bool()> cancelled = [this, generation] { return generation_ != generation; };
+      SearchResult result;
+      if (!needle.empty()) {
+        bool exact = false;
+        auto cached = cache_.lookup(needle, broaderNeedles(needle), exact);
+        if (exact) {
+          result = *cached;
+        } else if (searchEngine(bible_, index_.folded(), pool_, needle, cached ? &cached->verses : nullptr,
+                                cancelled, result)) {
+          cache_.insert(needle, result);
+        } else {
+          continue;
+        }
+      }
+      last_verses_ = std::move(result.verses);
+      highlighter_ = Highlighter::forQuery(QueryPlan::substring(needle));
+      page_ = 0;
+      deliver(generation, pageLines());
+    }
+  }
+
+  // Needles whose matches contain needle's and that typing it is likely to
+  // have cached: its proper prefixes and suffixes, longest first (the
+  // needle less its last or first character comes first). That is O(L)
+  // lookups per keystroke, where every substring would be O(L²).
+  static std::vector<std::string> broaderNeedles(const std::string& needle) {
+    std::vector<std::string> needles;
+    needles.reserve(2 * needle.size());
+    for (size_t length = needle.size() - 1; length > 0; length--) {
+      needles.push_back(needle.substr(0, length));
+      needles.push_back(needle.substr(needle.size() - length));
+    }
+    return needles;
+  }
+
+  // The current page of last_verses_, with a footer when there are more.
+  // Every match of the needle is found in the folded verse and mapped back
+  // to the original bytes, which is what gets highlighted.
+  std::vector<ResultLine> pageLines() const {
+    if (last_verses_.empty()) return { { "No matches found." } };
+    const size_t first = page_ * PAGE_SIZE;
+    const size_t last = std::min(last_verses_.size(), first + PAGE_SIZE);
+    std::vector<ResultLine> lines;
+    lines.reserve(last - first + 1);
+    const FoldedText* folded = index_.folded();
+    FoldBuffer buffer;
+    for (size_t i = first; i < last; i++) {
+      const uint32_t vi = last_verses_[i];
+      ResultLine line{ verseLine(bible_, vi) };
+      highlighter_.find(folded ? folded->verse(vi) : foldInto(bible_.verseText(vi), buffer), line.marks);
+      mergeRanges(line.marks);
+      const size_t prefix = line.text.size() - bible_.verseText(vi).size();
+      for (ByteRange& mark : line.marks) mark = { prefix + mark.first, prefix + mark.second };
+      lines.push_back(std::move(line));
+    }
+    if (last_verses_.size() > PAGE_SIZE) {
+      lines.push_back({ "-- Matches " + std::to_string(first + 1) + "-" + std::to_string(last) + " of " +
+                        std::to_string(last_verses_.size()) + " ([ and ] or the page buttons for more) --" });
+    }
+    return lines;
+  }
+
+  // Hand lines to the UI unless a newer request superseded them
+  void deliver(uint64_t generation, std::vector<ResultLine> lines) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (generation_ != generation) return;
+      ready_ = std::move(lines);
+      has_ready_ = true;
+      paged_ = true;
+    }
+    notify_();
+  }
+
+  const Corpus& bible_;
+  const BackgroundIndex& index_;
+  ThreadPool& pool_;
+  std::function<void()> notify_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::atomic<uint64_t> generation_{0};
+  std::string pending_;
+  bool has_pending_ = false;
+  int page_turn_ = 0;        // pages to move, requested by turnPage()
+  bool paged_ = false;       // search results (not a message) are showing
+  bool stop_ = false;
+  std::vector<ResultLine> ready_;
+  bool has_ready_ = false;
+
+  QueryCache<SearchResult> cache_;
+
+  // Last completed search, touched by the worker thread only
+  std::vector<uint32_t> last_verses_;
+  Highlighter highlighter_;
+  size_t page_ = 0;
+
+  std::thread thread_;   // last, so it starts after everything above
+};
+
+// Uniform over all verses (not book, then chapter, then verse, which
+// favoured the short books)
+static std::string randomVerse(const Corpus& bible, VerseSampler& sampler) {
+  const uint32_t vi = sampler.pick("");
+  const uint32_t ci = bible.chapterOf(vi);
   std::ostringstream oss;
-  oss << b["book"] << " " << ch["chapter"] << ":" << v["verse"]
-      << " → " << v["text"];
+  writeQuoted(oss, bible.bookName(bible.bookOf(ci)));
+  oss << " " << bible.chapter(ci).number << ":" << bible.verse(vi).number << " → ";
+  writeQuoted(oss, bible.verseText(vi));
   return oss.str();
 }
 
-static Element highlightText(const std::string& line, const std::string& query) {
-  if (query.empty()) return text(line);
-
-  std::string lower_line = toLower(line);
-  std::string lower_query = toLower(query);
+static Element highlightText(const ResultLine& line) {
+  if (line.marks.empty()) return text(line.text);
 
-  size_t pos = lower_line.find(lower_query);
-  if (pos == std::string::npos) return text(line);
-
-  return hbox({
-    text(line.substr(0, pos)),
-    text(line.substr(pos, query.size())) | bold | color(Color::Green),
-    text(line.substr(pos + query.size()))
+  Elements pieces;
+  forEachHighlightPiece(line.text, line.marks, [&](std::string_view piece, bool marked) {
+    Element element = text(std::string(piece));
+    pieces.push_back(marked ? element | bold | color(Color::Green) : element);
   });
+  return hbox(std::move(pieces));
 }
 
 
 // --- Search Window ---
-Component SearchWindow(json& bible, ScreenInteractive& screen,
-                       std::string& input_query) {
+Component SearchWindow(const Corpus& bible, VerseSampler& sampler, SearchWorker& worker,
+                       ScreenInteractive& screen, std::string& input_query) {
   class Impl : public ComponentBase {
   public:
-    Impl(json& bible, ScreenInteractive& screen,
+    Impl(const Corpus& bible, VerseSampler& sampler, SearchWorker& worker, ScreenInteractive& screen,
          std::string& input_query) {
-      auto input = Input(&input_query, "Type search keyword...");
-
-      auto btn_search = Button("Search", [&] {
-        std::string query_copy = input_query;
-        json* bible_ptr = &bible;
-        ScreenInteractive* screen_ptr = &screen;
-
-        std::thread([bible_ptr, query_copy, screen_ptr]() {
-          new_results = searchEngine(*bible_ptr, query_copy);
-          has_new_results = true;
-          screen_ptr->PostEvent(Event::Custom); // signal UI
-        }).detach();
-      });
+      // Search as you type; Enter and the button re-run the current query.
+      // FTXUI 5's Input is multiline by default, so Enter also types a
+      // '\n', which is taken out again before it reaches the needle.
+      InputOption input_option;
+      input_option.on_change = [&] {
+        input_query.erase(std::remove(input_query.begin(), input_query.end(), '\n'), input_query.end());
+        worker.search(input_query);
+      };
+      input_option.on_enter = [&] { worker.search(input_query); };
+      auto input = Input(&input_query, "Type search keyword...", input_option);
+
+      auto btn_search = Button("Search", [&] { worker.search(input_query); });
 
       auto btn_random = Button("Random Verse", [&] {
-        json* bible_ptr = &bible;
-        ScreenInteractive* screen_ptr = &screen;
-
-        std::thread([bible_ptr, screen_ptr]() {
-          new_results = { randomVerse(*bible_ptr) };
-          has_new_results = true;
-          screen_ptr->PostEvent(Event::Custom);
-        }).detach();
+        worker.show({ randomVerse(bible, sampler) });
       });
 
       auto btn_quit = Button("Quit", screen.ExitLoopClosure());
@@ -181,39 +475,73 @@ Component SearchWindow(json& bible, ScreenInteractive& screen,
       }));
     }
   };
-  return Make<Impl>(bible, screen, input_query);
+  return Make<Impl>(bible, sampler, worker, screen, input_query);
 }
 
-Component ResultsWindow(std::vector<std::string>& output_lines, std::string& input_query) {
+// Only the rows on screen (plus a few above and below) are turned into
+// Elements. Highlighted rows are cached until the results change, and
+// scrolling moves the first visible row, so a frame costs the same for ten
+// results as for forty thousand.
+Component ResultsWindow(SearchWorker& worker, std::vector<ResultLine>& output_lines) {
   class Impl : public ComponentBase {
-    float scroll_y = 0.0f;
-    std::vector<std::string>& output_lines;
-    std::string& input_query;
+    const int overscan = 8;   // rows kept ready past each edge
+    int top = 0;          // first visible row
+    int max_top = 0;
+    int visible = 1;      // rows that fit, measured on the last frame
+    Box viewport;
+    std::unordered_map<size_t, Element> row_cache;
+    SearchWorker& worker;
+    std::vector<ResultLine>& output_lines;
+
+    Element row(size_t i) {
+      auto it = row_cache.find(i);
+      if (it != row_cache.end()) return it->second;
+      Element element = highlightText(output_lines[i]);
+      row_cache.emplace(i, element);
+      return element;
+    }
+
+    void scrollBy(int rows) {
+      top = std::clamp(top + rows, 0, max_top);
+    }
 
    public:
-    Impl(std::vector<std::string>& output_lines, std::string& input_query)
-        : output_lines(output_lines), input_query(input_query) {
+    Impl(SearchWorker& worker, std::vector<ResultLine>& output_lines)
+        : worker(worker), output_lines(output_lines) {
       auto content = Renderer([&] {
-        if (has_new_results) {
-          output_lines = std::move(new_results);
-          has_new_results = false;
+        if (worker.take(output_lines)) {
+          top = 0;
+          row_cache.clear();
         }
+
+        const int rows = output_lines.size();
+        visible = std::max(1, viewport.y_max - viewport.y_min + 1);
+        max_top = std::max(0, rows - visible);
+        top = std::clamp(top, 0, max_top);
+
+        // The viewport is only known after a frame, so also cover the
+        // terminal height in case the window just grew
+        const int first = std::max(0, top - overscan);
+        const int last = std::min(rows, top + std::max(visible, Terminal::Size().dimy) + overscan);
+        if (row_cache.size() > size_t(4 * (last - first))) row_cache.clear();
+
         std::vector<Element> lines;
-        for (auto& line : output_lines) {
-          lines.push_back(highlightText(line, input_query));
+        for (int i = first; i < last; i++) {
+          Element element = row(i);
+          if (i >= top) lines.push_back(element);
         }
         return vbox(lines);
       });
 
       auto scrollable_content = Renderer(content, [&, content] {
-        return content->Render() | focusPositionRelative(0.0f, scroll_y) | frame | flex;
+        return content->Render() | frame | flex | reflect(viewport);
       });
 
-      SliderOption<float> option_y;
-      option_y.value = &scroll_y;
-      option_y.min = 0.f;
-      option_y.max = 1.f;
-      option_y.increment = 0.05f;
+      SliderOption<int> option_y;
+      option_y.value = &top;
+      option_y.min = 0;
+      option_y.max = &max_top;
+      option_y.increment = 1;
       option_y.direction = Direction::Down;
       option_y.color_active = Color::Yellow;
       option_y.color_inactive = Color::YellowLight;
@@ -221,57 +549,85 @@ Component ResultsWindow(std::vector<std::string>& output_lines, std::string& inp
 
       auto btn_copy = Button("Copy First Result", [&] {
         if (!output_lines.empty()) {
-          copyToClipboard(output_lines[0]);
           // feedback message
-          new_results = { "Copied to clipboard!" };
-          has_new_results = true;
+          if (copyToClipboard(output_lines[0].text)) {
+            worker.show({ "Copied to clipboard!" });
+          } else {
+            worker.show({ "Clipboard tool not found. Install xclip, xsel, or wl-clipboard." });
+          }
         }
       });
 
+      auto btn_prev = Button("Previous Page", [&] { worker.turnPage(-1); });
+      auto btn_next = Button("Next Page", [&] { worker.turnPage(1); });
+
 Add(Container::Vertical({
   Container::Horizontal({ scrollable_content, scrollbar_y }) | flex,
-  btn_copy
+  Container::Horizontal({ btn_copy, btn_prev, btn_next })
 }));
 
     }
 
     bool OnEvent(Event event) override {
-      if (event == Event::ArrowUp) {
-        scroll_y = std::max(0.0f, scroll_y - 0.05f);
-        return true;
-      }
-      if (event == Event::ArrowDown) {
-        scroll_y = std::min(1.0f, scroll_y + 0.05f);
-        return true;
+      if (event == Event::ArrowUp) { scrollBy(-1); return true; }
+      if (event == Event::ArrowDown) { scrollBy(1); return true; }
+      if (event == Event::PageUp) { scrollBy(-visible); return true; }
+      if (event == Event::PageDown) { scrollBy(visible); return true; }
+      if (event == Event::Home) { top = 0; return true; }
+      if (event == Event::End) { top = max_top; return true; }
+      if (event == Event::Character('[')) { worker.turnPage(-1); return true; }
+      if (event == Event::Character(']')) { worker.turnPage(1); return true; }
+      if (event.is_mouse() && viewport.Contain(event.mouse().x, event.mouse().y)) {
+        if (event.mouse().button == Mouse::WheelUp) { scrollBy(-3); return true; }
+        if (event.mouse().button == Mouse::WheelDown) { scrollBy(3); return true; }
       }
       return ComponentBase::OnEvent(event);
     }
   };
 
-  return Make<Impl>(output_lines, input_query);
+  return Make<Impl>(worker, output_lines);
 }
 
 
 // --- Main ---
 int main(int argc, char* argv[]) {
-  std::ifstream file("nabre.json");
-  if (!file.is_open()) file.open(std::string(NABRETERM_DATADIR) + "/nabre.json");
-  if (!file.is_open()) {
-    std::cerr << "Could not open NABRE JSON file.\n";
-    return 1;
-  }
-  json bible; file >> bible;
+  Corpus bible;
+  if (!loadCorpus(bible)) return 1;
+
+  // One entry per book, so this is quick whatever the corpus size
+  VerseSampler sampler;
+  sampler.build(bible);
 
   auto screen = ScreenInteractive::Fullscreen();
 
+  // The folded copy of the verses that searches scan is built behind the
+  // UI, which is shown right away. Like the long-lived workers for searches
+  // (replacing a detached thread per click), it is declared after the
+  // screen so it is joined before the screen goes away.
+  BackgroundIndex index(bible, [&screen] { screen.PostEvent(Event::Custom); });
+  // The search worker's thread takes part in its scans, the UI thread
+  // does not: one pool thread fewer than defaultThreads() counts
+  ThreadPool pool(std::max(1u, ThreadPool::defaultThreads() - 1));
+  SearchWorker worker(bible, index, pool, [&screen] { screen.PostEvent(Event::Custom); });
+
   std::string input_query;
-  std::vector<std::string> output_lines = {"Welcome to NabretermUI"};
+  std::vector<ResultLine> output_lines = { { "Welcome to NabretermUI" } };
 
-  auto results_child = ResultsWindow(output_lines, input_query);
-  auto search_child = SearchWindow(bible, screen, input_query);
+  auto results_child = ResultsWindow(worker, output_lines);
+  auto search_child = SearchWindow(bible, sampler, worker, screen, input_query);
 
   auto search_window = Renderer(search_child, [&] {
-  return window(text("Search Controls"), search_child->Render())
+  Element controls = search_child->Render();
+  if (!index.folded()) {
+    // Searches work meanwhile, just more slowly
+    const float progress = index.progress();
+    controls = vbox({
+      controls,
+      hbox({ text("Indexing "), gauge(progress) | flex,
+             text(" " + std::to_string(int(progress * 100)) + "%") })
+    });
+  }
+  return window(text("Search Controls"), controls)
          | size(HEIGHT, GREATER_THAN, 3);   // never collapse below 3 lines
   });
 
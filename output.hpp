@@ -0,0 +1,224 @@
+// output.hpp
+// Buffered result writer for nabreterm's chapter, range, search and random
+// output.
+//
+// Result lines are appended to one reusable buffer that is written with a
+// single write per command (or whenever it grows past its capacity), not
+// streamed piecemeal through cout. The writer also carries the stream that
+// errors go to, so a command can be pointed at any pair of streams.
+//
+// Besides the colored human-readable layout the writer can emit one
+// machine-readable record per verse:
+//   plain   the human layout without ANSI escapes
+//   ndjson  {"book":"John","chapter":3,"verse":16,"text":"..."}
+//   tsv     book \t chapter \t verse \t text  (\t, \n, \r and \ escaped)
+// Color is only used for the human layout, and by default only when stdout
+// is a terminal.
+#ifndef NABRETERM_OUTPUT_HPP
+#define NABRETERM_OUTPUT_HPP
+
+#include "corpus.hpp"
+#include "stats.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+enum class OutputFormat {
+    Text,     // human layout, colored when enabled
+    Plain,
+    Ndjson,
+    Tsv
+};
+
+inline bool parseOutputFormat(std::string_view name, OutputFormat& format) {
+    if (name == "text") format = OutputFormat::Text;
+    else if (name == "plain") format = OutputFormat::Plain;
+    else if (name == "ndjson") format = OutputFormat::Ndjson;
+    else if (name == "tsv") format = OutputFormat::Tsv;
+    else return false;
+    return true;
+}
+
+inline bool stdoutIsTerminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdout));
+#else
+    return isatty(fileno(stdout));
+#endif
+}
+
+// One verse of a result, as the machine-readable formats print it
+struct VerseRecordView {
+    std::string_view book;
+    uint32_t chapter;
+    uint32_t verse;
+    std::string_view text;
+};
+
+inline void appendTsvField(std::string& out, std::string_view s) {
+    for (char c : s) {
+        switch (c) {
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\\': out += "\\\\"; break;
+            default:   out += c;
+        }
+    }
+}
+
+// Append one ndjson or tsv record; safe to call from worker threads on
+// their own buffers
+inline void appendRecord(std::string& out, OutputFormat format, const VerseRecordView& r) {
+    if (format == OutputFormat::Ndjson) {
+        out += "{\"book\":";
+        appendQuoted(out, r.book);
+        out += ",\"chapter\":" + std::to_string(r.chapter) + ",\"verse\":" + std::to_string(r.verse) + ",\"text\":";
+        appendQuoted(out, r.text);
+        out += "}\n";
+    } else {
+        appendTsvField(out, r.book);
+        out += '\t' + std::to_string(r.chapter) + '\t' + std::to_string(r.verse) + '\t';
+        appendTsvField(out, r.text);
+        out += '\n';
+    }
+}
+
+class OutputWriter {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+    OutputWriter(OutputFormat format, bool color, std::ostream& out = std::cout,
+                 std::ostream& err = std::cerr, size_t capacity = DEFAULT_CAPACITY)
+        : format_(format), color_(color && format == OutputFormat::Text), out_(out), err_(err),
+          capacity_(capacity) {
+        buffer_.reserve(capacity);
+    }
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+    ~OutputWriter() { flush(); }
+
+    OutputFormat format() const { return format_; }
+    // ndjson/tsv: callers emit records instead of their human layout
+    bool structured() const { return format_ == OutputFormat::Ndjson || format_ == OutputFormat::Tsv; }
+    bool color() const { return color_; }
+
+    // Messages (not found, did you mean...) go here, after a flush()
+    std::ostream& err() { return err_; }
+
+    // The escape sequence when color is on, "" otherwise
+    const char* ansi(const char* code) const { return color_ ? code : ""; }
+
+    // Human layout is built directly in the buffer; call commit() after
+    // each line so a huge batch is written out in capacity-sized pieces
+    std::string& buffer() { return buffer_; }
+
+    void commit() {
+        if (buffer_.size() >= capacity_) flush();
+    }
+
+    void append(std::string_view s) {
+        buffer_ += s;
+        commit();
+    }
+
+    void record(const VerseRecordView& r) {
+        appendRecord(buffer_, format_, r);
+        commit();
+    }
+
+    // Write everything buffered so far; called at the end of every command
+    // (before anything goes to stderr, so terminal output stays in order)
+    void flush() {
+        if (buffer_.empty()) return;
+        ScopedTimer timer(StatPhase::Write);
+        addStat(StatCounter::BytesWritten, buffer_.size());
+        out_.write(buffer_.data(), buffer_.size());
+        out_.flush();
+        buffer_.clear();
+    }
+
+private:
+    OutputFormat format_;
+    bool color_;
+    std::ostream& out_;
+    std::ostream& err_;
+    size_t capacity_;
+    std::string buffer_;
+};
+
+// --- stdout/stderr captured in the order they were written ---
+// Lets a command run on another thread (a batch worker, a daemon client)
+// and be replayed afterwards exactly as it would have printed.
+class CapturedOutput {
+public:
+    CapturedOutput() : outBuf_(*this, false), errBuf_(*this, true), out_(&outBuf_), err_(&errBuf_) {}
+
+    CapturedOutput(const CapturedOutput&) = delete;
+    CapturedOutput& operator=(const CapturedOutput&) = delete;
+
+    std::ostream& out() { return out_; }
+    std::ostream& err() { return err_; }
+
+    // (is stderr, bytes), consecutive writes to one stream merged
+    const std::vector<std::pair<bool, std::string>>& frames() {
+        out_.flush();
+        err_.flush();
+        return frames_;
+    }
+
+    void replay(std::ostream& out, std::ostream& err) {
+        for (auto& frame : frames()) {
+            std::ostream& stream = frame.first ? err : out;
+            stream.write(frame.second.data(), frame.second.size());
+            stream.flush();
+        }
+    }
+
+private:
+    class ChannelBuf : public std::streambuf {
+    public:
+        ChannelBuf(CapturedOutput& owner, bool isErr) : owner_(owner), isErr_(isErr) {}
+
+    protected:
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            owner_.append(isErr_, s, n);
+            return n;
+        }
+        int_type overflow(int_type c) override {
+            if (c != traits_type::eof()) {
+                char ch = traits_type::to_char_type(c);
+                owner_.append(isErr_, &ch, 1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+    private:
+        CapturedOutput& owner_;
+        bool isErr_;
+    };
+
+    void append(bool isErr, const char* s, std::streamsize n) {
+        if (frames_.empty() || frames_.back().first != isErr) frames_.emplace_back(isErr, std::string());
+        frames_.back().second.append(s, n);
+    }
+
+    std::vector<std::pair<bool, std::string>> frames_;
+    ChannelBuf outBuf_, errBuf_;
+    std::ostream out_, err_;
+};
+
+#endif // NABRETERM_OUTPUT_HPP
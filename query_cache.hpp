@@ -0,0 +1,147 @@
+// query_cache.hpp
+// Bounded LRU cache of search results, used by nabreterm's SearchIndex and
+// nabretermui's search worker.
+//
+// Entries are keyed by a normalized query (QueryPlan::cacheKey() for the
+// boolean grammar, the folded needle in nabretermui) and hold result sets
+// of verse IDs, never formatted lines. Once the entries' bytes pass the
+// budget the least recently used ones are dropped. A miss can still be
+// narrowed down: the caller lists the keys of broader queries whose results
+// would contain its own, and gets the smallest of those that is cached.
+// Every call locks, so batch workers and daemon clients share one cache.
+#ifndef NABRETERM_QUERY_CACHE_HPP
+#define NABRETERM_QUERY_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Value needs `size_t bytes() const`, its approximate heap footprint
+template <class Value>
+class QueryCache {
+public:
+    static constexpr size_t DEFAULT_BUDGET = size_t(32) << 20;
+
+    using Entry = std::shared_ptr<const Value>;
+
+    struct Counters {
+        uint64_t hits = 0;
+        uint64_t supersetHits = 0;   // misses answered inside a broader query
+        uint64_t misses = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+    };
+
+    explicit QueryCache(size_t budget = DEFAULT_BUDGET) : budget_(budget) {}
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    // 0 turns the cache off (and empties it)
+    void setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        budget_ = bytes;
+        evict();
+    }
+
+    bool enabled() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return budget_ > 0;
+    }
+
+    // The entry for key, else the smallest cached entry among supersetKeys
+    // (exact is false then), else null. Counts a hit, superset hit or miss.
+    Entry lookup(const std::string& key, const std::vector<std::string>& supersetKeys, bool& exact) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exact = false;
+        if (Node* node = touch(key)) {
+            exact = true;
+            counters_.hits++;
+            return node->value;
+        }
+        Node* best = nullptr;
+        for (const std::string& k : supersetKeys) {
+            Node* node = touch(k);
+            if (node && (!best || node->bytes < best->bytes)) best = node;
+        }
+        if (best) {
+            counters_.supersetHits++;
+            return best->value;
+        }
+        counters_.misses++;
+        return nullptr;
+    }
+
+    // Store (or replace) key's result, then evict down to the budget
+    void insert(const std::string& key, Value value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (budget_ == 0) return;
+        erase(key);
+        const size_t bytes = key.size() + value.bytes() + NODE_OVERHEAD;
+        if (bytes > budget_) return;   // would only evict everything else
+        order_.push_front({ key, std::make_shared<const Value>(std::move(value)), bytes });
+        index_.emplace(key, order_.begin());
+        bytes_ += bytes;
+        evict();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        order_.clear();
+        index_.clear();
+        bytes_ = 0;
+    }
+
+    Counters counters() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Counters c = counters_;
+        c.entries = order_.size();
+        c.bytes = bytes_;
+        c.budget = budget_;
+        return c;
+    }
+
+private:
+    static constexpr size_t NODE_OVERHEAD = 96;   // list node, map slot, control block
+
+    struct Node {
+        std::string key;
+        Entry value;
+        size_t bytes;
+    };
+
+    // Move key's node to the front (most recently used), null if absent
+    Node* touch(const std::string& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) return nullptr;
+        order_.splice(order_.begin(), order_, it->second);
+        return &*it->second;
+    }
+
+    void erase(const std::string& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) return;
+        bytes_ -= it->second->bytes;
+        order_.erase(it->second);
+        index_.erase(it);
+    }
+
+    void evict() {
+        while (bytes_ > budget_ && !order_.empty()) erase(order_.back().key);
+    }
+
+    mutable std::mutex mutex_;
+    size_t budget_;
+    size_t bytes_ = 0;
+    std::list<Node> order_;   // most recently used first
+    std::unordered_map<std::string, typename std::list<Node>::iterator> index_;
+    Counters counters_;
+};
+
+#endif // NABRETERM_QUERY_CACHE_HPP
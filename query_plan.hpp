@@ -0,0 +1,561 @@
+// query_plan.hpp
+// Search query grammar and its compiled form.
+//
+// tokenize() + toPostfix() turn "faith && !(sin || death)" into postfix, and
+// QueryPlan compiles that once per query: keywords are folded up front,
+// regex keywords are compiled once, and the postfix is lowered to a register
+// program (the stack depth of every step is known at compile time), so
+// evaluating a verse needs neither a stack nor any allocation.
+//
+// Besides keywords the grammar has quoted phrases ("kingdom of heaven", whole
+// words in order) and the binary NEAR/n operator (faith NEAR/3 hope: within
+// n words of each other), both matched on word positions rather than text.
+#ifndef NABRETERM_QUERY_PLAN_HPP
+#define NABRETERM_QUERY_PLAN_HPP
+
+#include "levenshtein.hpp"
+#include "stats.hpp"
+#include "text_fold.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <regex>
+#include <stack>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct SearchOptions {
+    int fuzzyDistance = 2;   // max edits for the fuzzy fallback, 0 disables it
+    bool crossVerse = false; // phrases and NEAR may span verses of one chapter
+    bool ranked = false;     // BM25 order instead of canonical order
+    size_t limit = 0;        // results per page, 0 = all
+    size_t offset = 0;       // results skipped before the page
+};
+
+inline char asciiLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+// std::regex's \w in the classic locale
+inline bool isWordChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Runs of word characters in folded text: the words phrases and NEAR count
+inline std::vector<std::string> wordTokens(std::string_view text) {
+    std::vector<std::string> words(1);
+    for (char c : text) {
+        if (isWordChar(c)) words.back().push_back(c);
+        else if (!words.back().empty()) words.emplace_back();
+    }
+    if (words.back().empty()) words.pop_back();
+    return words;
+}
+
+// "NEAR/n" (any case); the distance goes to distance
+inline bool isNearOperator(const std::string& tok, int* distance = nullptr) {
+    if (tok.size() < 6 || tok[4] != '/') return false;
+    for (size_t i = 0; i < 4; i++) {
+        if (asciiLower(tok[i]) != "near"[i]) return false;
+    }
+    int n = 0;
+    for (size_t i = 5; i < tok.size(); i++) {
+        if (!isdigit((unsigned char)tok[i]) || n > 100000) return false;
+        n = n * 10 + (tok[i] - '0');
+    }
+    if (distance) *distance = n;
+    return true;
+}
+
+// --- Tokenizer: split into words, "phrases", operators, parentheses ---
+inline std::vector<std::string> tokenize(const std::string& query) {
+    std::vector<std::string> tokens;
+    std::string token;
+
+    for (size_t i = 0; i < query.size(); i++) {
+        char c = query[i];
+
+        if (c == '"') {
+            // A phrase keeps its opening quote as a marker; an unclosed one
+            // runs to the end of the query
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+            size_t close = query.find('"', i + 1);
+            if (close == std::string::npos) close = query.size();
+            tokens.push_back(query.substr(i, close - i));
+            i = close;
+        }
+        else if (isspace((unsigned char)c)) {
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+        }
+        else if (c == '(' || c == ')') {
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+            tokens.push_back(std::string(1, c));
+        }
+        else if (c == '&' && i+1 < query.size() && query[i+1] == '&') {
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+            tokens.push_back("&&");
+            i++; // skip second &
+        }
+        else if (c == '|' && i+1 < query.size() && query[i+1] == '|') {
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+            tokens.push_back("||");
+            i++; // skip second |
+        }
+        else if (c == '!') {
+            if (!token.empty()) {
+                tokens.push_back(token);
+                token.clear();
+            }
+            tokens.push_back("!");
+        }
+        else {
+            token.push_back(c);
+        }
+    }
+
+    if (!token.empty()) tokens.push_back(token);
+    return tokens;
+}
+
+// --- Operator precedence helper ---
+inline int precedence(const std::string& op) {
+    if (op == "&&") return 2;
+    if (op == "||") return 1;
+    if (op == "!")  return 3;
+    if (isNearOperator(op)) return 4;
+    return 0;
+}
+
+// --- Shunting-yard: infix → postfix ---
+inline std::vector<std::string> toPostfix(const std::vector<std::string>& tokens) {
+    std::vector<std::string> output;
+    std::stack<std::string> ops;
+    for (auto& tok : tokens) {
+        if (tok == "&&" || tok == "||" || tok == "!" || isNearOperator(tok)) {
+            while (!ops.empty() && precedence(ops.top()) >= precedence(tok)) {
+                output.push_back(ops.top());
+                ops.pop();
+            }
+            ops.push(tok);
+        } else if (tok == "(") {
+            ops.push(tok);
+        } else if (tok == ")") {
+            while (!ops.empty() && ops.top() != "(") {
+                output.push_back(ops.top());
+                ops.pop();
+            }
+            if (!ops.empty()) ops.pop(); // discard "("
+        } else {
+            output.push_back(tok); // keyword
+        }
+    }
+    while (!ops.empty()) {
+        output.push_back(ops.top());
+        ops.pop();
+    }
+    return output;
+}
+
+// --- Compiled query ---
+enum class TermKind : uint8_t {
+    Prefix,      // plain word: some word of the verse starts with it
+    Regex,       // anything else: `\b<kw>\w*\b`, as the search has always done
+    Substring,   // nabretermui: case-insensitive substring of the verse
+    Phrase,      // "quoted": these whole words, consecutive
+    Near         // left NEAR/distance right, over two other terms
+};
+
+struct QueryTerm {
+    std::string token;       // as typed
+    std::string folded;      // folded like the verse text (text_fold.hpp)
+    TermKind kind = TermKind::Prefix;
+    std::regex pattern;      // `\b<kw>\w*\b`, for Regex terms and highlighting
+    std::vector<std::string> words;   // Phrase: its words, folded
+    uint32_t left = 0, right = 0;     // Near: operand terms
+    int distance = 0;                 // Near: max words between them
+    bool operand = false;             // only matched as part of a NEAR
+};
+
+// Word positions first..last (inclusive) of one match
+struct TokenSpan {
+    uint32_t first, last;
+};
+
+// Phrase matches: every p with p + i in lists[i] for all i (lists sorted)
+inline std::vector<uint32_t> phraseStarts(const std::vector<std::vector<uint32_t>>& lists) {
+    if (lists.empty()) return {};
+    std::vector<uint32_t> starts = lists[0];
+    for (uint32_t i = 1; i < lists.size() && !starts.empty(); i++) {
+        size_t kept = 0, j = 0;
+        for (uint32_t p : starts) {
+            while (j < lists[i].size() && lists[i][j] < p + i) j++;
+            if (j < lists[i].size() && lists[i][j] == p + i) starts[kept++] = p;
+        }
+        starts.resize(kept);
+    }
+    return starts;
+}
+
+// Call fn(a, b) for each pair of spans at most distance words apart; both
+// lists sorted, and spans of one list all the same length
+template <class Fn>
+void forEachNear(const std::vector<TokenSpan>& a, const std::vector<TokenSpan>& b, int distance, Fn fn) {
+    size_t from = 0;
+    for (const TokenSpan& x : a) {
+        while (from < b.size() && int64_t(b[from].last) + distance < int64_t(x.first)) from++;
+        for (size_t j = from; j < b.size() && int64_t(b[j].first) <= int64_t(x.last) + distance; j++) fn(x, b[j]);
+    }
+}
+
+enum class QueryOp : uint8_t { Term, And, Or, Not };
+
+// reg[dst] = reg[lhs] op reg[rhs], or reg[dst] = term for Term
+struct QueryInstruction {
+    QueryOp op;
+    uint8_t dst, lhs, rhs;
+    uint32_t term;
+};
+
+class QueryPlan {
+public:
+    static constexpr size_t MAX_REGISTERS = 64;
+
+    // Boolean keyword query (the CLI/REPL grammar)
+    static QueryPlan compile(const std::string& query, const SearchOptions& options = {}) {
+        QueryPlan plan;
+        plan.options_ = options;
+        plan.highlight_ = query.find('!') == std::string::npos;
+
+        std::vector<std::string> postfix;
+        {
+            ScopedTimer timer(StatPhase::Parse);
+            postfix = toPostfix(tokenize(query));
+        }
+        size_t depth = 0;
+        for (auto& tok : postfix) {
+            QueryInstruction in{};
+            if (tok == "&&" || tok == "||") {
+                if (depth < 2) { plan.valid_ = false; break; }
+                in.op = tok == "&&" ? QueryOp::And : QueryOp::Or;
+                in.dst = in.lhs = depth - 2;
+                in.rhs = depth - 1;
+                depth--;
+            } else if (tok == "!") {
+                if (depth < 1) { plan.valid_ = false; break; }
+                in.op = QueryOp::Not;
+                in.dst = in.lhs = depth - 1;
+            } else if (isNearOperator(tok)) {
+                // Folds the two operand terms into one positional term
+                if (!plan.addNear(tok)) break;
+                depth--;
+                continue;
+            } else {
+                if (depth == MAX_REGISTERS) {
+                    plan.error_ = "Query is too long.";
+                    plan.valid_ = false;
+                    break;
+                }
+                in.op = QueryOp::Term;
+                in.dst = depth++;
+                in.term = plan.terms_.size();
+                if (!plan.addTerm(tok)) break;
+            }
+            plan.program_.push_back(in);
+            plan.registers_ = std::max(plan.registers_, depth);
+        }
+        plan.result_ = depth > 0 ? depth - 1 : 0;
+        plan.empty_ = postfix.empty();
+        if (plan.valid_ && depth == 0) plan.valid_ = false;
+        return plan;
+    }
+
+    // Whether any term is matched on word positions (phrase or NEAR)
+    bool positional() const {
+        for (auto& term : terms_) {
+            if (term.kind == TermKind::Phrase || term.kind == TermKind::Near) return true;
+        }
+        return false;
+    }
+
+    // Single case-insensitive substring (nabretermui's search box)
+    static QueryPlan substring(const std::string& query) {
+        QueryPlan plan;
+        plan.options_.fuzzyDistance = 0;
+        plan.valid_ = !query.empty();
+        if (query.empty()) return plan;
+        QueryTerm term;
+        term.token = query;
+        term.folded = foldText(query);
+        term.kind = TermKind::Substring;
+        plan.terms_.push_back(std::move(term));
+        plan.program_.push_back({ QueryOp::Term, 0, 0, 0, 0 });
+        plan.registers_ = 1;
+        return plan;
+    }
+
+    // No keywords at all: every verse matches
+    bool empty() const { return empty_; }
+    // Malformed (operator without operands, bad regex): nothing matches
+    bool valid() const { return valid_; }
+    const std::string& error() const { return error_; }
+    // Search output is highlighted unless the query uses NOT
+    bool highlight() const { return highlight_; }
+
+    const SearchOptions& options() const { return options_; }
+    const std::vector<QueryTerm>& terms() const { return terms_; }
+    const std::vector<QueryInstruction>& program() const { return program_; }
+    size_t registerCount() const { return registers_; }
+    size_t resultRegister() const { return result_; }
+
+    // Normalized query for result caching: the program rendered back to
+    // infix, with keywords as typed and the options that change the result,
+    // so spacing and redundant parentheses don't make a different key
+    std::string cacheKey() const { return renderKey(conjuncts()); }
+
+    // Keys of broader queries whose results contain this one's: for the
+    // top-level conjuncts a && b && c, those of a, a && b, b and c
+    std::vector<std::string> supersetKeys() const {
+        std::vector<std::string> parts = conjuncts(), keys;
+        for (size_t n = 1; n < parts.size(); n++) {
+            keys.push_back(renderKey({ parts.begin(), parts.begin() + n }));
+        }
+        for (size_t i = 1; i < parts.size(); i++) {
+            if (std::find(parts.begin(), parts.begin() + i, parts[i]) == parts.begin() + i) {
+                keys.push_back(renderKey({ parts[i] }));
+            }
+        }
+        return keys;
+    }
+
+    // Exact test of one term against one verse's folded text, without the
+    // fuzzy fallback
+    static bool termMatchesText(const QueryTerm& term, std::string_view text) {
+        const std::string& kw = term.folded;
+        switch (term.kind) {
+            case TermKind::Prefix:
+                for (size_t i = text.find(kw); i != std::string_view::npos; i = text.find(kw, i + 1)) {
+                    if (i == 0 || !isWordChar(text[i-1])) return true;
+                }
+                return false;
+            case TermKind::Substring:
+                return text.find(kw) != std::string_view::npos;
+            case TermKind::Regex:
+                return std::regex_search(text.begin(), text.end(), term.pattern);
+            case TermKind::Phrase:
+            case TermKind::Near:
+                return false;    // need the plan: see spansInText()
+        }
+        return false;
+    }
+
+    // Matches of a Prefix, Phrase or Near term among a verse's words
+    std::vector<TokenSpan> spansInText(const QueryTerm& term, const std::vector<std::string>& words) const {
+        std::vector<TokenSpan> spans;
+        if (term.kind == TermKind::Near) {
+            std::vector<TokenSpan> a = spansInText(terms_[term.left], words);
+            std::vector<TokenSpan> b = spansInText(terms_[term.right], words);
+            forEachNear(a, b, term.distance, [&](const TokenSpan& x, const TokenSpan& y) {
+                spans.push_back({ std::min(x.first, y.first), std::max(x.last, y.last) });
+            });
+        } else if (term.kind == TermKind::Phrase) {
+            std::vector<std::vector<uint32_t>> lists(term.words.size());
+            for (uint32_t p = 0; p < words.size(); p++) {
+                for (size_t i = 0; i < term.words.size(); i++) {
+                    if (words[p] == term.words[i]) lists[i].push_back(p);
+                }
+            }
+            for (uint32_t p : phraseStarts(lists)) spans.push_back({ p, p + uint32_t(term.words.size()) - 1 });
+        } else {
+            for (uint32_t p = 0; p < words.size(); p++) {
+                if (words[p].compare(0, term.folded.size(), term.folded) == 0) spans.push_back({ p, p });
+            }
+        }
+        return spans;
+    }
+
+    // Some whitespace-separated word of the folded verse is within maxDist edits
+    static bool termMatchesFuzzy(const QueryTerm& term, std::string_view text, int maxDist) {
+        if (maxDist <= 0) return false;
+        LevenshteinPattern pattern(term.folded);
+        size_t i = 0;
+        while (i < text.size()) {
+            while (i < text.size() && isspace((unsigned char)text[i])) i++;
+            size_t start = i;
+            while (i < text.size() && !isspace((unsigned char)text[i])) i++;
+            if (i > start && pattern.distance(text.substr(start, i - start), maxDist) <= maxDist) return true;
+        }
+        return false;
+    }
+
+    // Evaluate the plan on one verse's folded text
+    bool matches(std::string_view text) const {
+        if (empty_) return true;
+        if (!valid_) return false;
+        uint64_t reg = 0;
+        for (const QueryInstruction& in : program_) {
+            bool value = false;
+            switch (in.op) {
+                case QueryOp::Term: {
+                    const QueryTerm& term = terms_[in.term];
+                    if (term.kind == TermKind::Phrase || term.kind == TermKind::Near) {
+                        value = !spansInText(term, wordTokens(text)).empty();
+                    } else {
+                        value = termMatchesText(term, text) || termMatchesFuzzy(term, text, options_.fuzzyDistance);
+                    }
+                    break;
+                }
+                case QueryOp::And: value = (reg >> in.lhs & 1) && (reg >> in.rhs & 1); break;
+                case QueryOp::Or:  value = (reg >> in.lhs & 1) || (reg >> in.rhs & 1); break;
+                case QueryOp::Not: value = !(reg >> in.lhs & 1); break;
+            }
+            reg = (reg & ~(uint64_t(1) << in.dst)) | (uint64_t(value) << in.dst);
+        }
+        return reg >> result_ & 1;
+    }
+
+private:
+    bool addTerm(const std::string& tok) {
+        QueryTerm term;
+        if (tok[0] == '"') {
+            term.token = tok.substr(1);
+            term.kind = TermKind::Phrase;
+            term.words = wordTokens(foldText(term.token));
+            for (auto& word : term.words) term.folded += (term.folded.empty() ? "" : " ") + word;
+            if (term.words.empty()) {
+                error_ = "Empty phrase.";
+                valid_ = false;
+                return false;
+            }
+            terms_.push_back(std::move(term));
+            return true;
+        }
+        term.token = tok;
+        term.folded = foldText(tok);
+        term.kind = std::all_of(term.folded.begin(), term.folded.end(), isWordChar)
+            ? TermKind::Prefix : TermKind::Regex;
+        try {
+            ScopedTimer timer(StatPhase::RegexCompile);
+            term.pattern = std::regex("\\b" + term.folded + "\\w*\\b", std::regex_constants::icase);
+            addStat(StatCounter::RegexesCompiled);
+        } catch (const std::regex_error&) {
+            error_ = "Invalid search pattern: " + tok;
+            valid_ = false;
+            return false;
+        }
+        terms_.push_back(std::move(term));
+        return true;
+    }
+
+    // Top-level conjuncts of the result, each rendered in infix
+    std::vector<std::string> conjuncts() const {
+        struct Node {
+            QueryOp op;
+            std::vector<std::string> parts;   // operands of a flattened && or ||
+        };
+        auto render = [](const Node& node) {
+            if (node.parts.size() == 1) return node.parts[0];
+            std::string out = "(";
+            for (size_t i = 0; i < node.parts.size(); i++) {
+                if (i > 0) out += node.op == QueryOp::And ? " && " : " || ";
+                out += node.parts[i];
+            }
+            return out + ")";
+        };
+        std::vector<Node> reg(registers_);
+        for (const QueryInstruction& in : program_) {
+            switch (in.op) {
+                case QueryOp::Term: reg[in.dst] = { QueryOp::Term, { termKey(in.term) } }; break;
+                case QueryOp::And:
+                case QueryOp::Or: {
+                    Node node{ in.op, {} };
+                    for (uint8_t side : { in.lhs, in.rhs }) {
+                        const Node& operand = reg[side];
+                        if (operand.op == in.op) {
+                            node.parts.insert(node.parts.end(), operand.parts.begin(), operand.parts.end());
+                        } else {
+                            node.parts.push_back(render(operand));
+                        }
+                    }
+                    reg[in.dst] = std::move(node);
+                    break;
+                }
+                case QueryOp::Not: reg[in.dst] = { QueryOp::Not, { "!" + render(reg[in.lhs]) } }; break;
+            }
+        }
+        if (reg.empty()) return {};
+        const Node& result = reg[result_];
+        return result.op == QueryOp::And ? result.parts : std::vector<std::string>{ render(result) };
+    }
+
+    std::string termKey(uint32_t t) const {
+        const QueryTerm& term = terms_[t];
+        switch (term.kind) {
+            case TermKind::Phrase: return "\"" + term.folded + "\"";
+            case TermKind::Near: return "(" + termKey(term.left) + " " + term.token + " " + termKey(term.right) + ")";
+            default: return term.token;
+        }
+    }
+
+    std::string renderKey(const std::vector<std::string>& parts) const {
+        std::string key;
+        for (size_t i = 0; i < parts.size(); i++) key += (i ? " && " : "") + parts[i];
+        return key + "\x1f" + std::to_string(options_.fuzzyDistance) + (options_.crossVerse ? "x" : "");
+    }
+
+    // The last two instructions are the operands' Term loads; they become
+    // one Near term in the first one's register
+    bool addNear(const std::string& tok) {
+        size_t n = program_.size();
+        bool operands = n >= 2 && program_[n - 2].op == QueryOp::Term && program_[n - 1].op == QueryOp::Term
+            && program_[n - 1].dst == program_[n - 2].dst + 1;
+        for (size_t i = n >= 2 ? n - 2 : n; operands && i < n; i++) {
+            TermKind kind = terms_[program_[i].term].kind;
+            operands = kind == TermKind::Prefix || kind == TermKind::Phrase;
+        }
+        if (!operands) {
+            error_ = tok + " needs a word or a phrase on each side.";
+            valid_ = false;
+            return false;
+        }
+        QueryTerm near;
+        near.token = tok;
+        near.kind = TermKind::Near;
+        near.left = program_[n - 2].term;
+        near.right = program_[n - 1].term;
+        isNearOperator(tok, &near.distance);
+        terms_[near.left].operand = terms_[near.right].operand = true;
+        program_[n - 2].term = terms_.size();
+        program_.pop_back();
+        terms_.push_back(std::move(near));
+        return true;
+    }
+
+    SearchOptions options_;
+    std::vector<QueryTerm> terms_;
+    std::vector<QueryInstruction> program_;
+    size_t registers_ = 0;
+    size_t result_ = 0;
+    bool empty_ = false;
+    bool valid_ = true;
+    bool highlight_ = true;
+    std::string error_;
+};
+
+#endif // NABRETERM_QUERY_PLAN_HPP
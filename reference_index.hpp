@@ -0,0 +1,174 @@
+// reference_index.hpp
+// Load-time lookup tables for "Book Chapter[:Verse[-Verse]]" references.
+//
+// Book names resolve through a hash of lowercased names (fuzzy matching is
+// only tried when that misses), and each book's chapters are laid out in a
+// dense per-book slot table indexed by chapter number, stored as parallel
+// arrays. A chapter lookup is therefore two array reads, and a verse range
+// is a binary search over the chapter's slice of the verse-number column.
+#ifndef NABRETERM_REFERENCE_INDEX_HPP
+#define NABRETERM_REFERENCE_INDEX_HPP
+
+#include "corpus.hpp"
+#include "levenshtein.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Verse IDs [first, last)
+struct VerseRange {
+    uint32_t first = 0;
+    uint32_t last = 0;
+    bool empty() const { return first == last; }
+};
+
+class ReferenceIndex {
+public:
+    static constexpr uint32_t NO_BOOK = UINT32_MAX;
+
+    void build(const Corpus& corpus) {
+        const uint32_t books = corpus.bookCount();
+        byName_.clear();
+        minChapter_.assign(books, 0);
+        slotBase_.assign(books + 1, 0);
+        slotFirst_.clear();
+        slotCount_.clear();
+        slotSorted_.clear();
+        verseNumber_.resize(corpus.verseCount());
+
+        for (uint32_t v = 0; v < corpus.verseCount(); v++) verseNumber_[v] = corpus.verse(v).number;
+
+        for (uint32_t b = 0; b < books; b++) {
+            std::string name(corpus.bookName(b));
+            for (char& c : name) c = foldByte(c);
+            byName_.emplace(name, b);
+
+            const BookRecord& book = corpus.book(b);
+            uint32_t lo = UINT32_MAX, hi = 0;
+            for (uint32_t c = book.firstChapter; c < book.firstChapter + book.chapterCount; c++) {
+                lo = std::min(lo, corpus.chapter(c).number);
+                hi = std::max(hi, corpus.chapter(c).number);
+            }
+            const uint32_t span = book.chapterCount ? hi - lo + 1 : 0;
+            minChapter_[b] = book.chapterCount ? lo : 0;
+            slotBase_[b] = slotFirst_.size();
+            slotFirst_.resize(slotFirst_.size() + span, 0);
+            slotCount_.resize(slotCount_.size() + span, 0);
+            slotSorted_.resize(slotSorted_.size() + span, 1);
+
+            for (uint32_t c = book.firstChapter; c < book.firstChapter + book.chapterCount; c++) {
+                const ChapterRecord& ch = corpus.chapter(c);
+                uint32_t slot = slotBase_[b] + ch.number - lo;
+                if (slotCount_[slot] != 0) continue;      // keep the first of duplicate numbers
+                slotFirst_[slot] = ch.firstVerse;
+                slotCount_[slot] = ch.verseCount;
+                auto first = verseNumber_.begin() + ch.firstVerse;
+                slotSorted_[slot] = std::is_sorted(first, first + ch.verseCount);
+            }
+        }
+        slotBase_[books] = slotFirst_.size();
+    }
+
+    // Case-insensitive exact name, or NO_BOOK
+    uint32_t findBook(std::string_view name) const {
+        std::string key(name);
+        for (char& c : key) c = foldByte(c);
+        auto it = byName_.find(key);
+        return it == byName_.end() ? NO_BOOK : it->second;
+    }
+
+    // Exact name first, then the closest name within maxDist edits (first
+    // one wins ties, as the linear scan always did). NO_BOOK if none.
+    uint32_t resolveBook(const Corpus& corpus, std::string_view name, int maxDist = 2) const {
+        uint32_t exact = findBook(name);
+        if (exact != NO_BOOK) return exact;
+        LevenshteinPattern pattern(name);
+        uint32_t best = NO_BOOK;
+        int bestDist = maxDist + 1;
+        for (uint32_t b = 0; b < corpus.bookCount(); b++) {
+            int dist = pattern.distance(corpus.bookName(b), maxDist);
+            if (dist < bestDist) {
+                bestDist = dist;
+                best = b;
+            }
+        }
+        addStat(StatCounter::LevenshteinCalls, corpus.bookCount());
+        return best;
+    }
+
+    // Book of a citation like "Rom 8:28" or "1 John 4:8": spaces are
+    // ignored, then an exact name, then the first book (in canonical order)
+    // the name abbreviates, then the usual fuzzy match.
+    uint32_t resolveAbbreviation(const Corpus& corpus, std::string_view name, int maxDist = 2) const {
+        std::string key;
+        for (char c : name) {
+            if (c != ' ') key.push_back(foldByte(c));
+        }
+        uint32_t exact = findBook(key);
+        if (exact != NO_BOOK) return exact;
+        for (uint32_t b = 0; key.size() >= 2 && b < corpus.bookCount(); b++) {
+            std::string_view book = corpus.bookName(b);
+            if (book.size() < key.size()) continue;
+            size_t i = 0;
+            while (i < key.size() && foldByte(book[i]) == (unsigned char)key[i]) i++;
+            if (i == key.size()) return b;
+        }
+        return resolveBook(corpus, key, maxDist);
+    }
+
+    // All verses of a chapter
+    VerseRange chapter(uint32_t book, int number) const {
+        uint32_t slot = slotOf(book, number);
+        if (slot == NO_SLOT) return {};
+        return { slotFirst_[slot], slotFirst_[slot] + slotCount_[slot] };
+    }
+
+    // Verses of a chapter numbered start..end. When the chapter's verse
+    // numbers are not ascending the whole chapter is returned and the
+    // caller filters it, so odd data still prints what it used to.
+    VerseRange verses(uint32_t book, int number, int start, int end) const {
+        uint32_t slot = slotOf(book, number);
+        if (slot == NO_SLOT) return {};
+        VerseRange ch{ slotFirst_[slot], slotFirst_[slot] + slotCount_[slot] };
+        if (!slotSorted_[slot]) return ch;
+        start = std::max(start, 0);
+        if (end < start) return { ch.first, ch.first };
+        auto base = verseNumber_.begin();
+        auto first = std::lower_bound(base + ch.first, base + ch.last, (uint32_t)start);
+        auto last = std::upper_bound(first, base + ch.last, (uint32_t)end);
+        return { uint32_t(first - base), uint32_t(last - base) };
+    }
+
+    uint32_t verseNumber(uint32_t verse) const { return verseNumber_[verse]; }
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    uint32_t slotOf(uint32_t book, int number) const {
+        if (book >= minChapter_.size() || number < (int)minChapter_[book]) return NO_SLOT;
+        uint64_t slot = slotBase_[book] + uint64_t(number - minChapter_[book]);
+        return slot < slotBase_[book + 1] ? uint32_t(slot) : NO_SLOT;
+    }
+
+    std::unordered_map<std::string, uint32_t> byName_;
+
+    // Per book
+    std::vector<uint32_t> minChapter_;
+    std::vector<uint32_t> slotBase_;       // books + 1 offsets into the slot arrays
+
+    // Per (book, chapter number - minChapter) slot
+    std::vector<uint32_t> slotFirst_;      // first verse ID
+    std::vector<uint32_t> slotCount_;      // verse count, 0 = no such chapter
+    std::vector<uint8_t> slotSorted_;      // verse numbers ascending
+
+    // Per verse
+    std::vector<uint32_t> verseNumber_;
+};
+
+#endif // NABRETERM_REFERENCE_INDEX_HPP
@@ -0,0 +1,623 @@
+// search_index.hpp
+// Token-level inverted index over the corpus, used by searchEngine().
+//
+// Keywords keep the semantics of the old per-verse scan: a verse matches when
+// one of its words starts with the keyword (the `\b<kw>\w*\b` regex), or when
+// one of its whitespace-separated words is within the fuzzy edit distance
+// (2 by default) of it. Both tests are answered from sorted term dictionaries
+// with delta/varint-coded posting lists of verse IDs, and the boolean
+// operators become set algebra.
+//
+// Every word (run of word characters) also has a position list: its indices
+// in one running count of words over the whole corpus. Phrases and NEAR/n
+// are answered by merging those lists, and a match may cross a verse
+// boundary only when SearchOptions::crossVerse allows it (never a chapter's).
+// The same lists give the per-verse term frequencies for BM25 ranking.
+//
+// All of it is built from the folded verse text (text_fold.hpp), which the
+// index keeps for text scans and highlighting; a compressed corpus is folded
+// a chapter at a time instead, as it is streamed.
+//
+// Results are kept in a QueryCache keyed by QueryPlan::cacheKey(). When only
+// a broader query (one of the top-level conjuncts) is cached, text scans are
+// limited to its verses and the result is intersected with it.
+#ifndef NABRETERM_SEARCH_INDEX_HPP
+#define NABRETERM_SEARCH_INDEX_HPP
+
+#include "corpus.hpp"
+#include "query_cache.hpp"
+#include "query_plan.hpp"
+#include "stats.hpp"
+#include "text_fold.hpp"
+#include "text_scan.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using VerseSet = std::vector<uint32_t>; // sorted verse IDs
+
+// How many distinct vocabulary words a keyword's fuzzy fallback pulled in
+struct FuzzyExpansion {
+    std::string keyword;
+    size_t terms = 0;
+};
+
+// What the cache keeps of an evaluate() call
+struct CachedEvaluation {
+    VerseSet verses;
+    std::vector<FuzzyExpansion> expansions;
+
+    size_t bytes() const {
+        size_t n = verses.capacity() * sizeof(uint32_t);
+        for (auto& e : expansions) n += sizeof(FuzzyExpansion) + e.keyword.capacity();
+        return n;
+    }
+};
+
+inline VerseSet intersectSets(const VerseSet& a, const VerseSet& b) {
+    VerseSet out;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+    return out;
+}
+
+inline VerseSet uniteSets(const VerseSet& a, const VerseSet& b) {
+    VerseSet out;
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+    return out;
+}
+
+inline VerseSet subtractSets(const VerseSet& a, const VerseSet& b) {
+    VerseSet out;
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+    return out;
+}
+
+// --- Sorted terms with compressed posting lists ---
+class PostingDictionary {
+public:
+    void build(std::unordered_map<std::string, VerseSet>& lists) {
+        terms_.clear();
+        offsets_.clear();
+        bytes_.clear();
+        terms_.reserve(lists.size());
+        for (auto& entry : lists) terms_.push_back(entry.first);
+        std::sort(terms_.begin(), terms_.end());
+
+        offsets_.reserve(terms_.size() + 1);
+        for (const std::string& term : terms_) {
+            offsets_.push_back(bytes_.size());
+            uint32_t prev = 0;
+            for (uint32_t id : lists[term]) {
+                uint32_t delta = id - prev;
+                prev = id;
+                while (delta >= 0x80) {
+                    bytes_.push_back(uint8_t(delta) | 0x80);
+                    delta >>= 7;
+                }
+                bytes_.push_back(uint8_t(delta));
+            }
+        }
+        offsets_.push_back(bytes_.size());
+        bytes_.shrink_to_fit();
+    }
+
+    size_t size() const { return terms_.size(); }
+    const std::string& term(size_t i) const { return terms_[i]; }
+
+    // Index of term, or size() when absent
+    size_t find(const std::string& term) const {
+        auto it = std::lower_bound(terms_.begin(), terms_.end(), term);
+        return it != terms_.end() && *it == term ? it - terms_.begin() : terms_.size();
+    }
+
+    // Append the posting list of term i to out
+    void decode(size_t i, VerseSet& out) const {
+        uint32_t id = 0;
+        for (size_t p = offsets_[i]; p < offsets_[i + 1];) {
+            uint32_t delta = 0;
+            int shift = 0;
+            uint8_t byte;
+            do {
+                byte = bytes_[p++];
+                delta |= uint32_t(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            id += delta;
+            out.push_back(id);
+        }
+    }
+
+    // Call fn(i) for every term within maxDist edits of word. This walks the
+    // sorted list as a trie, reusing the DP rows of the shared prefix with the
+    // previous term and skipping every term below a prefix that is already
+    // more than maxDist edits away.
+    template <class Fn>
+    void forEachWithin(const std::string& word, int maxDist, Fn fn) const {
+        const size_t m = word.size();
+        std::vector<int> rows(m + 1);
+        for (size_t j = 0; j <= m; j++) rows[j] = j;
+        size_t depth = 0;                 // rows valid for terms_[prev][0, depth)
+        const std::string* prev = nullptr;
+        uint64_t evaluated = 0;
+
+        for (size_t i = 0; i < terms_.size(); evaluated++) {
+            const std::string& term = terms_[i];
+            size_t common = 0;
+            if (prev) {
+                while (common < depth && common < term.size() && term[common] == (*prev)[common]) common++;
+            }
+            if (rows.size() < (term.size() + 1) * (m + 1)) rows.resize((term.size() + 1) * (m + 1));
+
+            size_t d = common + 1;
+            bool pruned = false;
+            for (; d <= term.size(); d++) {
+                int* row = &rows[d * (m + 1)];
+                const int* above = row - (m + 1);
+                row[0] = d;
+                int best = row[0];
+                for (size_t j = 1; j <= m; j++) {
+                    int cost = (term[d - 1] == word[j - 1]) ? 0 : 1;
+                    row[j] = std::min({ above[j] + 1, row[j - 1] + 1, above[j - 1] + cost });
+                    best = std::min(best, row[j]);
+                }
+                if (best > maxDist) { pruned = true; break; }
+            }
+
+            prev = &term;
+            if (pruned) {
+                // No extension of term[0, d) can come back within range
+                depth = d - 1;
+                auto first = terms_.begin() + i + 1;
+                auto last = std::partition_point(first, terms_.end(), [&](const std::string& t) {
+                    return t.compare(0, d, term, 0, d) == 0;
+                });
+                i = last - terms_.begin();
+                continue;
+            }
+            depth = term.size();
+            if (rows[term.size() * (m + 1) + m] <= maxDist) fn(i);
+            i++;
+        }
+        addStat(StatCounter::LevenshteinCalls, evaluated);
+    }
+
+    // [first, last) of the terms starting with prefix
+    std::pair<size_t, size_t> prefixRange(const std::string& prefix) const {
+        auto first = std::lower_bound(terms_.begin(), terms_.end(), prefix);
+        auto last = first;
+        while (last != terms_.end() && last->compare(0, prefix.size(), prefix) == 0) ++last;
+        return { size_t(first - terms_.begin()), size_t(last - terms_.begin()) };
+    }
+
+private:
+    std::vector<std::string> terms_;
+    std::vector<uint32_t> offsets_;   // size() + 1 byte offsets into bytes_
+    std::vector<uint8_t> bytes_;
+};
+
+// --- Inverted index ---
+class SearchIndex {
+public:
+    bool built() const { return corpus_ != nullptr; }
+
+    void build(const Corpus& corpus) {
+        ScopedTimer timer(StatPhase::IndexBuild);
+        cache_.clear();
+        std::unordered_map<std::string, VerseSet> termLists, wordLists, positionLists;
+        std::string term, word;
+        uint32_t position = 0;
+
+        auto add = [](std::unordered_map<std::string, VerseSet>& lists, std::string& key, uint32_t v) {
+            if (key.empty()) return;
+            VerseSet& list = lists[key];
+            if (list.empty() || list.back() != v) list.push_back(v);
+            key.clear();
+        };
+        auto addTerm = [&](uint32_t v) {
+            if (term.empty()) return;
+            positionLists[term].push_back(position++);
+            add(termLists, term, v);
+        };
+
+        tokenStart_.resize(corpus.verseCount() + 1);
+        verseChapter_.resize(corpus.verseCount());
+        for (uint32_t c = 0; c < corpus.chapterCount(); c++) {
+            const ChapterRecord& ch = corpus.chapter(c);
+            for (uint32_t v = ch.firstVerse; v < ch.firstVerse + ch.verseCount; v++) verseChapter_[v] = c;
+        }
+        corpus_ = &corpus;
+        folded_ = FoldedText();
+        if (!corpus.compressed()) folded_.build(corpus);
+        forEachFoldedVerse([&](uint32_t v, const FoldedView& verse) {
+            tokenStart_[v] = position;
+            for (char c : verse.text) {
+                if (isWordChar(c)) term.push_back(c);
+                else addTerm(v);
+                if (isspace((unsigned char)c)) add(wordLists, word, v);
+                else word.push_back(c);
+            }
+            addTerm(v);
+            add(wordLists, word, v);
+        });
+        tokenStart_[corpus.verseCount()] = position;
+
+        terms_.build(termLists);
+        positions_.build(positionLists);   // same keys, so same indices as terms_
+        words_.build(wordLists);
+    }
+
+    // Verse v folded, from the kept copy or else into buffer
+    FoldedView foldedVerse(uint32_t v, FoldBuffer& buffer) const {
+        return folded_.built() ? folded_.verse(v) : foldInto(corpus_->verseText(v), buffer);
+    }
+
+    VerseSet allVerses() const {
+        VerseSet all(corpus_->verseCount());
+        for (uint32_t v = 0; v < all.size(); v++) all[v] = v;
+        return all;
+    }
+
+    // Run a compiled query: the plan's register program over verse sets.
+    // The fuzzy expansion of each keyword is appended to expansions when
+    // given; terms that need a text scan are sharded across pool if given.
+    // Word positions of phrase and NEAR matches go to matched when given
+    // (sorted, for positionRanges()), and each term's own verses to
+    // termHits (indexed like plan.terms(), for rank()). Only calls that want
+    // neither go through the cache, which keeps just the result.
+    VerseSet evaluate(const QueryPlan& plan, std::vector<FuzzyExpansion>* expansions = nullptr,
+                      ThreadPool* pool = nullptr, std::vector<uint32_t>* matched = nullptr,
+                      std::vector<VerseSet>* termHits = nullptr) const {
+        ScopedTimer timer(StatPhase::Evaluate);
+        if (plan.empty()) return allVerses();
+        if (!plan.valid()) return {};
+
+        const bool cached = !matched && !termHits && cache_.enabled();
+        std::string key;
+        QueryCache<CachedEvaluation>::Entry broader;
+        if (cached) {
+            key = plan.cacheKey();
+            bool exact = false;
+            broader = cache_.lookup(key, plan.supersetKeys(), exact);
+            addStat(broader ? StatCounter::CacheHits : StatCounter::CacheMisses);
+            if (exact) {
+                if (expansions) expansions->insert(expansions->end(), broader->expansions.begin(), broader->expansions.end());
+                return broader->verses;
+            }
+        }
+        std::vector<FuzzyExpansion> ownExpansions;
+        if (cached && !expansions) expansions = &ownExpansions;
+        const size_t firstExpansion = expansions ? expansions->size() : 0;
+        const VerseSet* within = broader ? &broader->verses : nullptr;
+
+        if (termHits) termHits->assign(plan.terms().size(), {});
+        std::vector<VerseSet> reg(plan.registerCount());
+        for (const QueryInstruction& in : plan.program()) {
+            switch (in.op) {
+                case QueryOp::Term: {
+                    const QueryTerm& term = plan.terms()[in.term];
+                    if (term.kind == TermKind::Phrase || term.kind == TermKind::Near) {
+                        reg[in.dst] = matchPositional(plan, term, matched);
+                    } else {
+                        reg[in.dst] = matchTerm(term, plan.options(), expansions, pool, within);
+                    }
+                    if (termHits) (*termHits)[in.term] = reg[in.dst];
+                    break;
+                }
+                case QueryOp::And: reg[in.dst] = intersectSets(reg[in.lhs], reg[in.rhs]); break;
+                case QueryOp::Or:  reg[in.dst] = uniteSets(reg[in.lhs], reg[in.rhs]); break;
+                case QueryOp::Not: reg[in.dst] = subtractSets(allVerses(), reg[in.lhs]); break;
+            }
+        }
+        if (matched) {
+            std::sort(matched->begin(), matched->end());
+            matched->erase(std::unique(matched->begin(), matched->end()), matched->end());
+        }
+        VerseSet result = std::move(reg[plan.resultRegister()]);
+        if (within) result = intersectSets(result, *within);
+        if (cached) {
+            cache_.insert(key, { result, { expansions->begin() + firstExpansion, expansions->end() } });
+        }
+        return result;
+    }
+
+    // Shared by every search on this index
+    QueryCache<CachedEvaluation>& cache() const { return cache_; }
+
+    // BM25 (k1 = 1.2, b = 0.75, verses as documents) of verses (sorted IDs)
+    // for the plan's terms outside a NOT. Returns the indices into verses of
+    // the k best, best first, with ties in canonical order; a heap of k
+    // keeps this O(n log k). termHits comes from evaluate().
+    std::vector<size_t> rank(const QueryPlan& plan, const std::vector<uint32_t>& verses,
+                             const std::vector<VerseSet>& termHits, size_t k) const {
+        const double K1 = 1.2, B = 0.75;
+        const double n = corpus_->verseCount();
+        const double avgLength = std::max(1.0, tokenStart_.back() / std::max(1.0, n));
+        std::vector<double> score(verses.size(), 0);
+
+        for (uint32_t t : scoringTerms(plan)) {
+            const QueryTerm& term = plan.terms()[t];
+            const VerseSet& hits = termHits[t];
+            if (hits.empty()) continue;
+            const double idf = std::log(1 + (n - hits.size() + 0.5) / (hits.size() + 0.5));
+
+            // Word positions give the term frequency; regex, substring and
+            // fuzzy-only matches count once
+            std::vector<uint32_t> occurrences;
+            if (term.kind == TermKind::Prefix) {
+                occurrences = positionsOf(term.folded, true);
+            } else if (term.kind == TermKind::Phrase || term.kind == TermKind::Near) {
+                for (const TokenSpan& span : spans(plan, term)) occurrences.push_back(span.first);
+                std::sort(occurrences.begin(), occurrences.end());
+            }
+
+            size_t h = 0, o = 0;
+            for (size_t i = 0; i < verses.size(); i++) {
+                const uint32_t v = verses[i];
+                while (h < hits.size() && hits[h] < v) h++;
+                if (h == hits.size() || hits[h] != v) continue;
+                uint32_t tf = 0;
+                while (o < occurrences.size() && occurrences[o] < tokenStart_[v]) o++;
+                for (; o < occurrences.size() && occurrences[o] < tokenStart_[v + 1]; o++) tf++;
+                tf = std::max(tf, 1u);
+                const double length = tokenStart_[v + 1] - tokenStart_[v];
+                score[i] += idf * tf * (K1 + 1) / (tf + K1 * (1 - B + B * length / avgLength));
+            }
+        }
+
+        // Heap top is the worst result kept so far
+        auto better = [&](size_t a, size_t b) { return score[a] != score[b] ? score[a] > score[b] : a < b; };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(better)> best(better);
+        for (size_t i = 0; i < verses.size() && k > 0; i++) {
+            if (best.size() < k) {
+                best.push(i);
+            } else if (better(i, best.top())) {
+                best.pop();
+                best.push(i);
+            }
+        }
+        std::vector<size_t> order(best.size());
+        for (size_t i = order.size(); i-- > 0; best.pop()) order[i] = best.top();
+        return order;
+    }
+
+    // Byte ranges in verse v (its original text) of the words at the given
+    // positions (sorted), adjacent words joined into one range
+    std::vector<std::pair<size_t, size_t>> positionRanges(uint32_t v, const std::vector<uint32_t>& positions) const {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        auto next = std::lower_bound(positions.begin(), positions.end(), tokenStart_[v]);
+        if (next == positions.end() || *next >= tokenStart_[v + 1]) return ranges;
+        FoldBuffer buffer;
+        const FoldedView verse = foldedVerse(v, buffer);
+        std::string_view text = verse.text;
+        uint32_t position = tokenStart_[v];
+        bool joinable = false;    // the previous word was highlighted
+        for (size_t i = 0; i < text.size() && next != positions.end();) {
+            if (!isWordChar(text[i])) {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            while (i < text.size() && isWordChar(text[i])) i++;
+            if (position == *next) {
+                if (joinable) ranges.back().second = i;
+                else ranges.push_back({ start, i });
+                ++next;
+                joinable = true;
+            } else {
+                joinable = false;
+            }
+            position++;
+        }
+        for (auto& range : ranges) range = verse.originalRange(range.first, range.second);
+        return ranges;
+    }
+
+private:
+    // Text scans only test the verses in within, when given
+    VerseSet matchTerm(const QueryTerm& term, const SearchOptions& options,
+                       std::vector<FuzzyExpansion>* expansions, ThreadPool* pool,
+                       const VerseSet* within = nullptr) const {
+        VerseSet hits;
+
+        if (term.kind == TermKind::Prefix) {
+            auto range = terms_.prefixRange(term.folded);
+            for (size_t t = range.first; t < range.second; t++) terms_.decode(t, hits);
+            addStat(StatCounter::PostingsDecoded, hits.size());
+        } else {
+            // Regex and substring terms scan the text with the compiled term
+            hits = scan(term, pool, within);
+        }
+
+        // Fuzzy fallback, run once against the distinct words
+        if (options.fuzzyDistance > 0) {
+            size_t expanded = 0, before = hits.size();
+            words_.forEachWithin(term.folded, options.fuzzyDistance, [&](size_t w) {
+                words_.decode(w, hits);
+                expanded++;
+            });
+            if (expansions) expansions->push_back({ term.token, expanded });
+            addStat(StatCounter::PostingsDecoded, hits.size() - before);
+        }
+
+        std::sort(hits.begin(), hits.end());
+        hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+        return hits;
+    }
+
+    // Terms the result register depends on, minus those under an odd
+    // number of NOTs
+    static std::vector<uint32_t> scoringTerms(const QueryPlan& plan) {
+        std::vector<std::vector<uint32_t>> reg(plan.registerCount());
+        std::vector<bool> negated(plan.terms().size(), false);
+        for (const QueryInstruction& in : plan.program()) {
+            switch (in.op) {
+                case QueryOp::Term: reg[in.dst] = { in.term }; break;
+                case QueryOp::And:
+                case QueryOp::Or: {
+                    std::vector<uint32_t> both = reg[in.lhs];
+                    both.insert(both.end(), reg[in.rhs].begin(), reg[in.rhs].end());
+                    reg[in.dst] = std::move(both);
+                    break;
+                }
+                case QueryOp::Not:
+                    for (uint32_t t : reg[in.lhs]) negated[t] = !negated[t];
+                    reg[in.dst] = reg[in.lhs];
+                    break;
+            }
+        }
+        std::vector<uint32_t> terms;
+        for (uint32_t t : reg[plan.resultRegister()]) {
+            if (!negated[t]) terms.push_back(t);
+        }
+        return terms;
+    }
+
+    // Sorted positions of the words starting with prefix (a keyword), or of
+    // exactly word (a phrase word)
+    std::vector<uint32_t> positionsOf(const std::string& word, bool prefix) const {
+        std::vector<uint32_t> positions;
+        std::pair<size_t, size_t> range;
+        if (prefix) {
+            range = positions_.prefixRange(word);
+        } else {
+            range.first = positions_.find(word);
+            range.second = std::min(range.first + 1, positions_.size());
+        }
+        for (size_t t = range.first; t < range.second; t++) positions_.decode(t, positions);
+        if (range.second - range.first > 1) std::sort(positions.begin(), positions.end());
+        addStat(StatCounter::PostingsDecoded, positions.size());
+        return positions;
+    }
+
+    // Whether words first..last may form one match
+    bool sameUnit(uint32_t first, uint32_t last, const SearchOptions& options) const {
+        uint32_t a = verseOf(first), b = verseOf(last);
+        return a == b || (options.crossVerse && verseChapter_[a] == verseChapter_[b]);
+    }
+
+    uint32_t verseOf(uint32_t position) const {
+        return std::upper_bound(tokenStart_.begin(), tokenStart_.end(), position) - tokenStart_.begin() - 1;
+    }
+
+    // Matches of a Prefix, Phrase or Near term; a NEAR match's two operand
+    // spans also go to parts when given
+    std::vector<TokenSpan> spans(const QueryPlan& plan, const QueryTerm& term,
+                                 std::vector<TokenSpan>* parts = nullptr) const {
+        std::vector<TokenSpan> spans;
+        if (term.kind == TermKind::Near) {
+            std::vector<TokenSpan> a = this->spans(plan, plan.terms()[term.left]);
+            std::vector<TokenSpan> b = this->spans(plan, plan.terms()[term.right]);
+            forEachNear(a, b, term.distance, [&](const TokenSpan& x, const TokenSpan& y) {
+                TokenSpan both{ std::min(x.first, y.first), std::max(x.last, y.last) };
+                if (!sameUnit(both.first, both.last, plan.options())) return;
+                spans.push_back(both);
+                if (parts) {
+                    parts->push_back(x);
+                    parts->push_back(y);
+                }
+            });
+        } else if (term.kind == TermKind::Phrase) {
+            std::vector<std::vector<uint32_t>> lists;
+            for (auto& word : term.words) {
+                lists.push_back(positionsOf(word, false));
+                if (lists.back().empty()) return spans;
+            }
+            const uint32_t length = term.words.size();
+            for (uint32_t p : phraseStarts(lists)) {
+                if (sameUnit(p, p + length - 1, plan.options())) spans.push_back({ p, p + length - 1 });
+            }
+        } else {
+            for (uint32_t p : positionsOf(term.folded, true)) spans.push_back({ p, p });
+        }
+        return spans;
+    }
+
+    // Verses touched by the term's matches; their words go to matched
+    VerseSet matchPositional(const QueryPlan& plan, const QueryTerm& term, std::vector<uint32_t>* matched) const {
+        VerseSet hits;
+        std::vector<TokenSpan> parts;   // NEAR: just the operands, not the words between them
+        std::vector<TokenSpan> found = spans(plan, term, &parts);
+        for (const TokenSpan& span : found) {
+            for (uint32_t v = verseOf(span.first); v <= verseOf(span.last); v++) hits.push_back(v);
+        }
+        if (matched) {
+            for (const TokenSpan& span : term.kind == TermKind::Near ? parts : found) {
+                for (uint32_t p = span.first; p <= span.last; p++) matched->push_back(p);
+            }
+        }
+        std::sort(hits.begin(), hits.end());
+        hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+        return hits;
+    }
+
+    // Call fn(v, folded verse) for every verse, or those in only (sorted),
+    // in order: from the kept copy, or folded as a compressed corpus streams
+    template <class Fn>
+    void forEachFoldedVerse(Fn fn, const VerseSet* only = nullptr) const {
+        if (folded_.built()) {
+            const uint32_t count = only ? only->size() : corpus_->verseCount();
+            for (uint32_t i = 0; i < count; i++) {
+                const uint32_t v = only ? (*only)[i] : i;
+                fn(v, folded_.verse(v));
+            }
+            return;
+        }
+        FoldBuffer buffer;
+        corpus_->forEachVerseText([&](uint32_t v, std::string_view text) { fn(v, foldInto(text, buffer)); }, only);
+    }
+
+    // Brute-force scan of the folded text, sharded into verse ranges whose
+    // hits are concatenated in range order. A compressed corpus is scanned
+    // in one streaming pass instead, a chapter at a time, so that a search
+    // does not leave the whole text inflated.
+    VerseSet scan(const QueryTerm& term, ThreadPool* pool, const VerseSet* within = nullptr) const {
+        const uint32_t count = within ? within->size() : corpus_->verseCount();
+        if (!folded_.built()) {
+            VerseSet hits;
+            forEachFoldedVerse([&](uint32_t v, const FoldedView& verse) {
+                if (QueryPlan::termMatchesText(term, verse.text)) hits.push_back(v);
+            }, within);
+            addStat(StatCounter::VersesScanned, count);
+            return hits;
+        }
+        auto scanRange = [&](size_t begin, size_t end, VerseSet& out) {
+            for (size_t i = begin; i < end; i++) {
+                const uint32_t v = within ? (*within)[i] : i;
+                if (QueryPlan::termMatchesText(term, folded_.verse(v).text)) out.push_back(v);
+            }
+            addStat(StatCounter::VersesScanned, end - begin);
+        };
+        VerseSet hits;
+        if (!pool) {
+            scanRange(0, count, hits);
+            return hits;
+        }
+        const size_t grain = pool->grainFor(count, 256);
+        std::vector<VerseSet> shards((count + grain - 1) / grain);
+        pool->parallelFor(count, grain, [&](size_t begin, size_t end, size_t chunk) {
+            scanRange(begin, end, shards[chunk]);
+        });
+        for (auto& shard : shards) hits.insert(hits.end(), shard.begin(), shard.end());
+        return hits;
+    }
+
+    const Corpus* corpus_ = nullptr;
+    FoldedText folded_;         // resident corpora only
+    PostingDictionary terms_;   // runs of word characters
+    PostingDictionary positions_;   // the same terms' word positions
+    PostingDictionary words_;   // whitespace-separated words, punctuation kept
+    std::vector<uint32_t> tokenStart_;     // verses + 1: position of each verse's first word
+    std::vector<uint32_t> verseChapter_;   // chapter of each verse
+    mutable QueryCache<CachedEvaluation> cache_;
+};
+
+#endif // NABRETERM_SEARCH_INDEX_HPP
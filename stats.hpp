@@ -0,0 +1,121 @@
+// stats.hpp
+// Opt-in phase timers and counters behind `--stats` and the REPL's `stats`.
+//
+// Nothing is recorded until enableStats(true): a disabled ScopedTimer is one
+// load of a global flag and never reads the clock, and hot loops count into
+// locals and publish the total once through addStat(). Values are relaxed
+// atomics, so pool workers and daemon clients can record concurrently.
+#ifndef NABRETERM_STATS_HPP
+#define NABRETERM_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+enum class StatPhase {
+    Load,          // corpus + reference tables
+    IndexBuild,    // SearchIndex::build
+    Parse,         // tokenize() + toPostfix()
+    RegexCompile,  // keyword regexes
+    Evaluate,      // SearchIndex::evaluate
+    Reference,     // chapter/range commands, their write included
+    Output,        // search result formatting and highlighting
+    Write,         // OutputWriter::flush
+    Count
+};
+
+enum class StatCounter {
+    VersesScanned,     // verse texts tested by a brute-force scan
+    PostingsDecoded,   // verse IDs read from posting lists
+    RegexesCompiled,
+    LevenshteinCalls,  // edit-distance evaluations (fuzzy words, book names)
+    VersesPrinted,
+    BytesWritten,
+    CacheHits,         // query results served (or narrowed) by the cache
+    CacheMisses,
+    Count
+};
+
+struct StatsRegistry {
+    std::atomic<bool> enabled{ false };
+    std::atomic<uint64_t> phaseNanos[size_t(StatPhase::Count)] = {};
+    std::atomic<uint64_t> phaseCalls[size_t(StatPhase::Count)] = {};
+    std::atomic<uint64_t> counters[size_t(StatCounter::Count)] = {};
+};
+
+inline StatsRegistry statsRegistry;
+
+inline bool statsEnabled() {
+    return statsRegistry.enabled.load(std::memory_order_relaxed);
+}
+
+inline void enableStats(bool on) {
+    statsRegistry.enabled.store(on, std::memory_order_relaxed);
+}
+
+inline void resetStats() {
+    for (auto& v : statsRegistry.phaseNanos) v.store(0, std::memory_order_relaxed);
+    for (auto& v : statsRegistry.phaseCalls) v.store(0, std::memory_order_relaxed);
+    for (auto& v : statsRegistry.counters) v.store(0, std::memory_order_relaxed);
+}
+
+inline void addStat(StatCounter counter, uint64_t n = 1) {
+    if (statsEnabled()) statsRegistry.counters[size_t(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+// Adds the time until the end of the scope to a phase
+class ScopedTimer {
+public:
+    explicit ScopedTimer(StatPhase phase) : phase_(phase), on_(statsEnabled()) {
+        if (on_) start_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() { stop(); }
+
+    // End the phase before the end of the scope
+    void stop() {
+        if (!on_) return;
+        on_ = false;
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        size_t p = size_t(phase_);
+        statsRegistry.phaseNanos[p].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                              std::memory_order_relaxed);
+        statsRegistry.phaseCalls[p].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    StatPhase phase_;
+    bool on_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Phases that ran, then all counters
+inline void reportStats(std::ostream& out) {
+    static const char* phaseNames[] = { "load", "index build", "parse", "regex compile",
+                                        "evaluate", "reference", "output", "write" };
+    static const char* counterNames[] = { "verses scanned", "postings decoded", "regexes compiled",
+                                          "levenshtein calls", "verses printed", "bytes written",
+                                          "cache hits", "cache misses" };
+    char line[96];
+    std::snprintf(line, sizeof line, "%-18s %8s %12s %12s\n", "phase", "calls", "total ms", "mean ms");
+    out << line;
+    for (size_t p = 0; p < size_t(StatPhase::Count); p++) {
+        uint64_t calls = statsRegistry.phaseCalls[p].load(std::memory_order_relaxed);
+        if (calls == 0) continue;
+        double ms = statsRegistry.phaseNanos[p].load(std::memory_order_relaxed) / 1e6;
+        std::snprintf(line, sizeof line, "%-18s %8llu %12.3f %12.3f\n", phaseNames[p],
+                      (unsigned long long)calls, ms, ms / calls);
+        out << line;
+    }
+    for (size_t c = 0; c < size_t(StatCounter::Count); c++) {
+        std::snprintf(line, sizeof line, "%-18s %8llu\n", counterNames[c],
+                      (unsigned long long)statsRegistry.counters[c].load(std::memory_order_relaxed));
+        out << line;
+    }
+}
+
+#endif // NABRETERM_STATS_HPP
@@ -0,0 +1,115 @@
+// corpus_test.cpp
+// Corpus::loadBinary and loadCompressed against damaged files: a truncated
+// or corrupt nabre.bin or nabre.nbz must be refused (validTables), never
+// mapped with tables that point outside the file.
+
+#include "../corpus.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    if (!ok) {
+        cout << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+static string readAll(const string& path) {
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+static void writeAll(const string& path, const string& data) {
+    ofstream(path, ios::binary | ios::trunc).write(data.data(), data.size());
+}
+
+// A copy of file with a uint32_t overwritten at offset
+static string patched(const string& file, uint64_t offset, uint32_t value) {
+    string data = file;
+    memcpy(&data[offset], &value, sizeof value);
+    return data;
+}
+
+int main() {
+    const filesystem::path dir = filesystem::temp_directory_path() / "nabreterm_corpus_test";
+    filesystem::create_directories(dir);
+    const string json = (dir / "nabre.json").string();
+    const string bin = (dir / "nabre.bin").string();
+    const string nbz = (dir / "nabre.nbz").string();
+    const string bad = (dir / "bad").string();
+
+    writeAll(json, R"([
+        {"book": "Genesis", "chapters": [
+            {"chapter": 1, "verses": [{"verse": 1, "text": "In the beginning"}, {"verse": 2, "text": "the earth"}]},
+            {"chapter": 2, "verses": [{"verse": 1, "text": "Thus the heavens"}]}]},
+        {"book": "John", "chapters": [
+            {"chapter": 1, "verses": [{"verse": 1, "text": "In the beginning was the Word"}]}]}
+    ])");
+    Corpus corpus;
+    check(corpus.loadJson(json), "load the JSON");
+    check(corpus.writeBinary(bin) && corpus.writeCompressed(nbz), "compile it");
+
+    Corpus loaded;
+    check(loaded.loadBinary(bin) && loaded.verseCount() == 4 && loaded.verseText(3) == "In the beginning was the Word",
+          "load nabre.bin");
+    check(loaded.loadCompressed(nbz) && loaded.verseText(1) == "the earth", "load nabre.nbz");
+
+    // Damaged files are reported on cerr; keep that out of the test log
+    ostringstream refusals;
+    streambuf* log = cerr.rdbuf(refusals.rdbuf());
+
+    // Truncated anywhere: in the header, the tables or the text
+    const string file = readAll(bin);
+    for (size_t size : { size_t(0), sizeof(CorpusHeader) - 1, sizeof(CorpusHeader), file.size() / 2, file.size() - 1 }) {
+        writeAll(bad, file.substr(0, size));
+        check(!loaded.loadBinary(bad), "nabre.bin truncated to " + to_string(size) + " bytes");
+    }
+    const string packed = readAll(nbz);
+    for (size_t size : { sizeof(BlockCorpusHeader), packed.size() / 2, packed.size() - 1 }) {
+        writeAll(bad, packed.substr(0, size));
+        check(!loaded.loadCompressed(bad), "nabre.nbz truncated to " + to_string(size) + " bytes");
+    }
+
+    // Corrupt headers and records
+    CorpusHeader h;
+    memcpy(&h, file.data(), sizeof h);
+    const uint64_t book1 = h.bookOffset + sizeof(BookRecord);
+    const uint64_t chapter1 = h.chapterOffset + sizeof(ChapterRecord);
+    const uint64_t verse3 = h.verseOffset + 3 * sizeof(VerseRecord);
+    const struct { const char* what; uint64_t offset; uint32_t value; } corruptions[] = {
+        { "bad magic", 0, 0 },
+        { "newer version", offsetof(CorpusHeader, version), CORPUS_VERSION + 1 },
+        { "more verses than the file holds", offsetof(CorpusHeader, verseCount), 1000 },
+        { "unaligned verse table", offsetof(CorpusHeader, verseOffset), uint32_t(h.verseOffset + 1) },
+        { "book name past the text", book1 + offsetof(BookRecord, nameOffset), uint32_t(h.textSize) },
+        { "book beyond the chapters", book1 + offsetof(BookRecord, chapterCount), 2 },
+        { "chapters out of order", chapter1 + offsetof(ChapterRecord, firstVerse), 1 },
+        { "chapter beyond the verses", chapter1 + offsetof(ChapterRecord, verseCount), 3 },
+        { "verse text past the end", verse3 + offsetof(VerseRecord, textOffset), uint32_t(h.textSize - 4) },
+        { "verse length overflowing", verse3 + offsetof(VerseRecord, textLength), UINT32_MAX },
+    };
+    for (auto& c : corruptions) {
+        writeAll(bad, patched(file, c.offset, c.value));
+        check(!loaded.loadBinary(bad), string("nabre.bin with ") + c.what);
+    }
+
+    cerr.rdbuf(log);
+
+    // Still loads after all that
+    check(loaded.loadBinary(bin) && loaded.bookName(1) == "John", "reload nabre.bin");
+
+    filesystem::remove_all(dir);
+    if (failures) return 1;
+    cout << "corpus_test: ok\n";
+    return 0;
+}
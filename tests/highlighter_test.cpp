@@ -0,0 +1,99 @@
+// highlighter_test.cpp
+// Highlighter's one-pass Aho–Corasick scan against the per-keyword regex
+// highlighting it replaced, on keywords that overlap (he, her, hers, she)
+// and texts full of them; plus the substring needle of nabretermui and
+// the mapping of folded ranges back onto accented text.
+
+#include "../highlighter.hpp"
+
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    if (!ok) {
+        cout << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+// Highlighting as it was: every keyword's `\b<kw>\w*\b` regex run over the
+// text on its own, the matches merged
+static vector<ByteRange> regexRanges(const QueryPlan& plan, const string& text) {
+    vector<ByteRange> ranges;
+    for (const QueryTerm& term : plan.terms()) {
+        if (term.operand || (term.kind != TermKind::Prefix && term.kind != TermKind::Regex)) continue;
+        for (sregex_iterator it(text.begin(), text.end(), term.pattern), end; it != end; ++it) {
+            ranges.push_back({ size_t(it->position()), size_t(it->position() + it->length()) });
+        }
+    }
+    mergeRanges(ranges);
+    return ranges;
+}
+
+static vector<ByteRange> highlighted(const Highlighter& highlighter, const string& text) {
+    vector<ByteRange> ranges;
+    highlighter.findFolded(text, ranges);
+    mergeRanges(ranges);
+    return ranges;
+}
+
+int main() {
+    mt19937 rng(3);
+    const vector<string> words = { "he", "her", "hers", "she", "ushers", "the", "there", "here", "hereby",
+                                   "h", "e", "sheher", "hehe", "love", "lo", "loved" };
+    const string separators[] = { " ", " ", ", ", ". ", "-", "'", "_" };
+    vector<string> texts = { "", "he", "hers", "she sells; he hers, her shehers-herhe" };
+    for (int t = 0; t < 500; t++) {
+        string text;
+        for (int n = 1 + rng() % 12; n > 0; n--) {
+            text += words[rng() % words.size()] + separators[rng() % size(separators)];
+        }
+        texts.push_back(text);
+    }
+
+    const string queries[] = {
+        "he || her || hers || she", "her || he", "hers && she", "h || he || her", "e", "the || there || here",
+        "lo.e || he", "lov || loved || love", "(he || she) && !xyzzy",
+    };
+    for (const string& query : queries) {
+        const QueryPlan plan = QueryPlan::compile(query);
+        const Highlighter highlighter = Highlighter::forQuery(plan);
+        check(plan.error().empty() && !highlighter.empty(), "compile " + query);
+        for (const string& text : texts) {
+            check(highlighted(highlighter, text) == regexRanges(plan, text), query + " in \"" + text + "\"");
+        }
+    }
+
+    // nabretermui's needle: every occurrence, overlapping ones merged
+    const Highlighter needle = Highlighter::forQuery(QueryPlan::substring("ere"));
+    for (const string& text : texts) {
+        vector<ByteRange> expected;
+        for (size_t at = text.find("ere"); at != string::npos; at = text.find("ere", at + 1)) {
+            expected.push_back({ at, at + 3 });
+        }
+        mergeRanges(expected);
+        check(highlighted(needle, text) == expected, "substring ere in \"" + text + "\"");
+    }
+    const Highlighter repeated = Highlighter::forQuery(QueryPlan::substring("aa"));
+    check(highlighted(repeated, "aaaa baa") == vector<ByteRange>({ { 0, 4 }, { 6, 8 } }), "substring aa");
+
+    // Ranges come back in the original bytes: É is two of them
+    const string verse = "Élie, ÉLIE and Elijah";
+    FoldBuffer buffer;
+    vector<ByteRange> ranges;
+    Highlighter::forQuery(QueryPlan::compile("elie || eli")).find(foldInto(verse, buffer), ranges);
+    mergeRanges(ranges);
+    check(ranges == vector<ByteRange>({ { 0, 5 }, { 7, 12 }, { 17, 23 } }), "ranges in accented text");
+
+    if (failures) return 1;
+    cout << "highlighter_test: ok\n";
+    return 0;
+}
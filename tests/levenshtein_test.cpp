@@ -0,0 +1,67 @@
+// levenshtein_test.cpp
+// The bounded kernel (LevenshteinPattern, whose words of up to 64 bytes go
+// through myers(), and levenshtein()) against the full-table legacy
+// levenshtein(), on mixed-case words either side of the 64-byte limit.
+
+#include "../levenshtein.hpp"
+#include "../bench/legacy_levenshtein.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    if (!ok) {
+        cout << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+int main() {
+    mt19937 rng(11);
+    const string letters = "abcABC";
+    auto word = [&](size_t length) {
+        string w;
+        for (size_t i = 0; i < length; i++) w += letters[rng() % letters.size()];
+        return w;
+    };
+    // A copy of w with up to edits random substitutions, insertions and deletions
+    auto mutate = [&](string w, int edits) {
+        for (int e = rng() % (edits + 1); e > 0; e--) {
+            const size_t at = w.empty() ? 0 : rng() % w.size();
+            switch (rng() % 3) {
+            case 0: if (!w.empty()) w[at] = letters[rng() % letters.size()]; break;
+            case 1: w.insert(w.begin() + at, letters[rng() % letters.size()]); break;
+            default: if (!w.empty()) w.erase(w.begin() + at); break;
+            }
+        }
+        return w;
+    };
+
+    const size_t lengths[] = { 0, 1, 2, 5, 13, 31, 63, 64, 65, 66, 100, 130 };
+    for (size_t length : lengths) {
+        for (int trial = 0; trial < 200; trial++) {
+            const string pattern = word(length);
+            // Mostly near misses, where the bound matters, and some unrelated words
+            const string text = trial % 4 == 0 ? word(rng() % 140) : mutate(pattern, 6);
+            const int exact = legacyLevenshtein(pattern, text);
+            const LevenshteinPattern compiled(pattern);
+            for (int maxDist = 0; maxDist <= 5; maxDist++) {
+                const int expected = exact <= maxDist ? exact : maxDist + 1;
+                const string what = "|pattern| " + to_string(pattern.size()) + ", |text| " + to_string(text.size())
+                                    + ", maxDist " + to_string(maxDist);
+                check(compiled.distance(text, maxDist) == expected, "LevenshteinPattern " + what);
+                check(levenshtein(pattern, text, maxDist) == expected, "levenshtein " + what);
+                check(levenshtein(text, pattern, maxDist) == expected, "levenshtein swapped " + what);
+            }
+        }
+    }
+
+    if (failures) return 1;
+    cout << "levenshtein_test: ok\n";
+    return 0;
+}
@@ -0,0 +1,96 @@
+// posting_test.cpp
+// PostingDictionary: varint delta lists decode to what was built (gaps of
+// one to five bytes included), and forEachWithin finds exactly the terms a
+// full edit-distance table says are within range.
+
+#include "../search_index.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const string& what) {
+    if (!ok) {
+        cout << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+// Textbook Levenshtein distance, the whole table
+static int distance(const string& a, const string& b) {
+    vector<vector<int>> d(a.size() + 1, vector<int>(b.size() + 1));
+    for (size_t i = 0; i <= a.size(); i++) d[i][0] = i;
+    for (size_t j = 0; j <= b.size(); j++) d[0][j] = j;
+    for (size_t i = 1; i <= a.size(); i++) {
+        for (size_t j = 1; j <= b.size(); j++) {
+            d[i][j] = min({ d[i-1][j] + 1, d[i][j-1] + 1, d[i-1][j-1] + (a[i-1] != b[j-1]) });
+        }
+    }
+    return d[a.size()][b.size()];
+}
+
+int main() {
+    mt19937 rng(7);
+
+    // Gaps at every varint length boundary, and lists of random gaps
+    unordered_map<string, VerseSet> lists = {
+        { "boundaries", { 0, 1, 128, 129, 129 + 127, 129 + 127 + 16383, 129 + 127 + 16383 + 16384,
+                          (1u << 21) + 500, (1u << 28) + 500, UINT32_MAX - 1, UINT32_MAX } },
+        { "first", { 200 } },
+        { "large", { 1u << 31 } },
+        { "empty", {} },
+    };
+    for (int t = 0; t < 200; t++) {
+        VerseSet& list = lists["term" + to_string(t)];
+        uint32_t id = 0;
+        for (int n = rng() % 50; n > 0; n--) {
+            const uint32_t gap = rng() % 4 == 0 ? rng() % (1u << 20) : rng() % 300;
+            id += gap + (list.empty() ? 0 : 1);
+            list.push_back(id);
+        }
+    }
+    auto expected = lists;
+    PostingDictionary dictionary;
+    dictionary.build(lists);
+    check(dictionary.size() == expected.size(), "one entry per term");
+    for (auto& entry : expected) {
+        const size_t i = dictionary.find(entry.first);
+        VerseSet decoded;
+        if (i < dictionary.size()) dictionary.decode(i, decoded);
+        check(i < dictionary.size() && decoded == entry.second, "decode " + entry.first);
+    }
+    check(dictionary.find("absent") == dictionary.size(), "find an absent term");
+
+    // forEachWithin against brute force over a vocabulary with shared prefixes
+    unordered_map<string, VerseSet> words;
+    const string letters = "abcde";
+    for (int t = 0; t < 2000; t++) {
+        string word;
+        for (int n = 1 + rng() % 7; n > 0; n--) word += letters[rng() % letters.size()];
+        words[word] = { 1 };
+    }
+    PostingDictionary vocabulary;
+    vocabulary.build(words);
+    for (const string word : { "a", "abc", "edcba", "aaaaaaa", "bead", "cabbage" }) {
+        for (int maxDist = 0; maxDist <= 3; maxDist++) {
+            vector<size_t> found, brute;
+            vocabulary.forEachWithin(word, maxDist, [&](size_t i) { found.push_back(i); });
+            for (size_t i = 0; i < vocabulary.size(); i++) {
+                if (distance(word, vocabulary.term(i)) <= maxDist) brute.push_back(i);
+            }
+            check(found == brute, "forEachWithin(" + word + ", " + to_string(maxDist) + ")");
+        }
+    }
+
+    if (failures) return 1;
+    cout << "posting_test: ok\n";
+    return 0;
+}
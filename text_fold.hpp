@@ -0,0 +1,192 @@
+// text_fold.hpp
+// Search folding of verse text, with a map back to the original bytes.
+//
+// Searches run on a folded copy of every verse, made once when the corpus
+// is indexed, and queries are folded the same way. Folding lowercases ASCII
+// and the Latin, Greek and Cyrillic capitals; strips Latin letters of their
+// diacritics (é → e, Æ → ae, ß → ss); turns curly quotes, primes and
+// guillemets into ' and ", dashes into -, the ellipsis into ... and Unicode
+// spaces into ' '; and drops soft hyphens, zero-width characters and
+// combining marks. So "Elie" finds "Élie" and 'Lord' finds ‘Lord’. Bytes
+// that are not valid UTF-8 are kept as they are.
+//
+// No character folds to more bytes than it takes in UTF-8, so the folded
+// text never runs ahead of the original. Where a character folds shorter
+// the two drift apart, and a pair of FoldAnchors records both offsets at
+// either end of it (so does one that folds into several letters, like Æ,
+// whose letters can be matched alone); between pairs they advance
+// together. ASCII-only verses need no anchors at all, and a match found in
+// the folded text maps back to exactly the original bytes it came from.
+#ifndef NABRETERM_TEXT_FOLD_HPP
+#define NABRETERM_TEXT_FOLD_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Offsets, relative to the start of one text, that the folding maps together
+struct FoldAnchor {
+    uint32_t folded, original;
+};
+
+// Folded text and the anchors mapping it back to the original: pairs, at
+// the start and the end of each character that does not map byte for byte
+struct FoldedView {
+    std::string_view text;
+    const FoldAnchor* anchors = nullptr;
+    size_t anchorCount = 0;
+
+    // Original offset of folded offset f. An offset inside the folding of
+    // one character (between the a and e of Æ's "ae") maps to that
+    // character's start, or to its end when roundUp.
+    size_t original(size_t f, bool roundUp = false) const {
+        const FoldAnchor* end = anchors + anchorCount;
+        const FoldAnchor* next = std::upper_bound(anchors, end, f, [](size_t value, const FoldAnchor& a) {
+            return value < a.folded;
+        });
+        if (next == anchors) return f;
+        const FoldAnchor& a = next[-1];
+        const bool inside = (next - anchors) % 2 == 1 && f > a.folded;
+        if (inside) return roundUp ? next->original : a.original;
+        return a.original + (f - a.folded);
+    }
+
+    // Original byte range of the folded range [begin, end)
+    std::pair<size_t, size_t> originalRange(size_t begin, size_t end) const {
+        return { original(begin), original(end, true) };
+    }
+};
+
+namespace fold_detail {
+
+// U+00C0..U+00FF; nullptr keeps the character (× and ÷)
+inline const char* const LATIN1[64] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", nullptr, "o", "u", "u", "u", "u", "y", "th", "y",
+};
+
+// U+0100..U+017F, one base letter each except Ĳ ĳ (ij) and Œ œ (oe)
+constexpr char LATIN_EXTENDED_A[] =
+    "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii__jjkkkllllllllll"
+    "nnnnnnnnnoooooo__rrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+static_assert(sizeof(LATIN_EXTENDED_A) == 129, "one letter per code point");
+
+inline void appendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xC0 | code >> 6);
+        out += char(0x80 | (code & 0x3F));
+    } else {
+        out += char(0xE0 | code >> 12);
+        out += char(0x80 | (code >> 6 & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    }
+}
+
+// The code point at in[i] and its length in bytes; 0 if not valid UTF-8
+inline size_t decodeUtf8(std::string_view in, size_t i, uint32_t& code) {
+    const unsigned char lead = in[i];
+    const size_t n = lead >= 0xF0 && lead < 0xF5 ? 4
+                     : lead >= 0xE0 && lead < 0xF0 ? 3
+                     : lead >= 0xC2 && lead < 0xE0 ? 2 : 0;
+    if (n == 0 || i + n > in.size()) return 0;
+    code = lead & (0x7F >> n);
+    for (size_t k = 1; k < n; k++) {
+        const unsigned char c = in[i + k];
+        if ((c & 0xC0) != 0x80) return 0;
+        code = code << 6 | (c & 0x3F);
+    }
+    const uint32_t least = n == 2 ? 0x80 : n == 3 ? 0x800 : 0x10000;
+    return code < least || code > 0x10FFFF || (code >= 0xD800 && code < 0xE000) ? 0 : n;
+}
+
+// Append the folding of code, a non-ASCII code point encoded as in
+inline void foldCodePoint(uint32_t code, std::string_view in, std::string& out) {
+    if ((code >= 0x300 && code < 0x370) || code == 0xAD || (code >= 0x200B && code <= 0x200D)
+        || code == 0x2060 || code == 0xFEFF) {
+        return;
+    }
+    if (code == 0xA0 || (code >= 0x2000 && code <= 0x200A) || code == 0x202F || code == 0x205F || code == 0x3000) {
+        out += ' ';
+    } else if ((code >= 0x2018 && code <= 0x201B) || code == 0x2032) {
+        out += '\'';
+    } else if ((code >= 0x201C && code <= 0x201F) || code == 0x2033 || code == 0xAB || code == 0xBB) {
+        out += '"';
+    } else if ((code >= 0x2010 && code <= 0x2015) || code == 0x2212) {
+        out += '-';
+    } else if (code == 0x2026) {
+        out += "...";
+    } else if (code >= 0xC0 && code < 0x100 && LATIN1[code - 0xC0]) {
+        out += LATIN1[code - 0xC0];
+    } else if (code >= 0x100 && code < 0x180) {
+        const char base = LATIN_EXTENDED_A[code - 0x100];
+        if (base != '_') out += base;
+        else out += code < 0x140 ? "ij" : "oe";
+    } else if ((code >= 0x391 && code <= 0x3A9) || (code >= 0x410 && code <= 0x42F)) {
+        appendUtf8(out, code + 0x20);     // Greek and Cyrillic capitals
+    } else if (code >= 0x400 && code < 0x410) {
+        appendUtf8(out, code + 0x50);     // Cyrillic Ѐ..Џ
+    } else {
+        out.append(in.data(), in.size());
+    }
+}
+
+} // namespace fold_detail
+
+// Append the folding of in to out. With anchors, also append the anchors
+// mapping it back to in (offsets relative to in and to its folding's start).
+inline void foldText(std::string_view in, std::string& out, std::vector<FoldAnchor>* anchors = nullptr) {
+    const size_t base = out.size();
+    for (size_t i = 0; i < in.size();) {
+        const char c = in[i];
+        if (!(c & 0x80)) {
+            out += (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+            i++;
+            continue;
+        }
+        uint32_t code = 0;
+        const size_t n = fold_detail::decodeUtf8(in, i, code);
+        if (n == 0) {
+            out += c;
+            i++;
+            continue;
+        }
+        const size_t start = out.size() - base;
+        fold_detail::foldCodePoint(code, in.substr(i, n), out);
+        const size_t length = out.size() - base - start;
+        if (anchors && (length != n || (length > 1 && !(out[base + start] & 0x80)))) {
+            anchors->push_back({ uint32_t(start), uint32_t(i) });
+            anchors->push_back({ uint32_t(start + length), uint32_t(i + n) });
+        }
+        i += n;
+    }
+}
+
+// Scratch space for folding one text at a time
+struct FoldBuffer {
+    std::string text;
+    std::vector<FoldAnchor> anchors;
+};
+
+// in, folded into buffer; the view is valid until the buffer is reused
+inline FoldedView foldInto(std::string_view in, FoldBuffer& buffer) {
+    buffer.text.clear();
+    buffer.anchors.clear();
+    foldText(in, buffer.text, &buffer.anchors);
+    return { buffer.text, buffer.anchors.data(), buffer.anchors.size() };
+}
+
+// A folded copy of s (queries, needles)
+inline std::string foldText(std::string_view s) {
+    std::string out;
+    foldText(s, out);
+    return out;
+}
+
+#endif // NABRETERM_TEXT_FOLD_HPP
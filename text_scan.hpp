@@ -0,0 +1,193 @@
+// text_scan.hpp
+// Folded copy of the verse texts and a vectorized substring scan over it.
+//
+// nabretermui's search box matches a case-insensitive substring anywhere in a
+// verse, and the CLI's keywords match on the same text. Instead of
+// lowercasing every verse on every search, FoldedText keeps one folded copy
+// (text_fold.hpp) of all verse texts in a single buffer (each verse followed
+// by a NUL so no match can span two verses) plus the start offset of every
+// verse and the anchors that map it back to the original. A search is then
+// one pass of findFolded() over the buffer, and each hit is mapped back to
+// its verse with a binary search of the offsets.
+//
+// findFolded() compares the needle's first and last bytes against 16 or 32
+// haystack positions at once and only verifies the candidates where both
+// agree. The AVX2 kernel is chosen at runtime when the CPU has it; SSE2 is
+// the x86-64 baseline, and other targets and compilers use the scalar loop.
+#ifndef NABRETERM_TEXT_SCAN_HPP
+#define NABRETERM_TEXT_SCAN_HPP
+
+#include "corpus.hpp"
+#include "text_fold.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define NABRETERM_SCAN_SSE2 1
+#define NABRETERM_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+
+constexpr size_t SCAN_NOT_FOUND = SIZE_MAX;
+
+// --- Substring kernels: first offset of needle in hay[0, n), or SCAN_NOT_FOUND ---
+inline size_t findFoldedScalar(const char* hay, size_t n, std::string_view needle) {
+    const size_t k = needle.size();
+    if (k == 0) return 0;
+    if (k > n) return SCAN_NOT_FOUND;
+    for (const char* p = hay; p + k <= hay + n; p++) {
+        p = static_cast<const char*>(std::memchr(p, needle[0], hay + n - k + 1 - p));
+        if (!p) return SCAN_NOT_FOUND;
+        if (std::memcmp(p + 1, needle.data() + 1, k - 1) == 0) return p - hay;
+    }
+    return SCAN_NOT_FOUND;
+}
+
+#ifdef NABRETERM_SCAN_SSE2
+inline size_t findFoldedSse2(const char* hay, size_t n, std::string_view needle) {
+    const size_t k = needle.size();
+    if (k < 2 || k > n) return findFoldedScalar(hay, n, needle);
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[k - 1]);
+    size_t i = 0;
+    for (; i + k - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + k - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (std::memcmp(hay + i + bit + 1, needle.data() + 1, k - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = findFoldedScalar(hay + i, n - i, needle);
+    return rest == SCAN_NOT_FOUND ? SCAN_NOT_FOUND : i + rest;
+}
+#endif
+
+#ifdef NABRETERM_SCAN_AVX2
+__attribute__((target("avx2")))
+inline size_t findFoldedAvx2(const char* hay, size_t n, std::string_view needle) {
+    const size_t k = needle.size();
+    if (k < 2 || k > n) return findFoldedScalar(hay, n, needle);
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+    size_t i = 0;
+    for (; i + k - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hay + i + k - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (std::memcmp(hay + i + bit + 1, needle.data() + 1, k - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = findFoldedSse2(hay + i, n - i, needle);
+    return rest == SCAN_NOT_FOUND ? SCAN_NOT_FOUND : i + rest;
+}
+#endif
+
+using FindFoldedFn = size_t (*)(const char*, size_t, std::string_view);
+
+// Best kernel for this CPU, picked once
+inline FindFoldedFn findFoldedKernel() {
+    static const FindFoldedFn kernel = [] {
+#ifdef NABRETERM_SCAN_AVX2
+        if (__builtin_cpu_supports("avx2")) return &findFoldedAvx2;
+#endif
+#ifdef NABRETERM_SCAN_SSE2
+        return &findFoldedSse2;
+#else
+        return &findFoldedScalar;
+#endif
+    }();
+    return kernel;
+}
+
+inline size_t findFolded(const char* hay, size_t n, std::string_view needle) {
+    return findFoldedKernel()(hay, n, needle);
+}
+
+// --- Folded verse column ---
+class FoldedText {
+public:
+    bool built() const { return !start_.empty(); }
+
+    // progress, when given, is called with the number of verses folded so
+    // far every 1024 verses; returning false from it abandons the build,
+    // which leaves nothing built and returns false
+    bool build(const Corpus& corpus, const std::function<bool(uint32_t)>& progress = {}) {
+        text_.clear();
+        anchors_.clear();
+        text_.reserve(corpus.textSize() + corpus.verseCount());
+        start_.resize(corpus.verseCount() + 1);
+        anchorStart_.resize(corpus.verseCount() + 1);
+        bool stopped = false;
+        corpus.forEachVerseText([&](uint32_t v, std::string_view text) {
+            start_[v] = text_.size();
+            anchorStart_[v] = anchors_.size();
+            foldText(text, text_, &anchors_);
+            text_.push_back('\0');
+            stopped = progress && (v + 1) % 1024 == 0 && !progress(v + 1);
+            return !stopped;
+        });
+        if (stopped) {
+            *this = FoldedText();
+            return false;
+        }
+        start_[corpus.verseCount()] = text_.size();
+        anchorStart_[corpus.verseCount()] = anchors_.size();
+        text_.shrink_to_fit();
+        anchors_.shrink_to_fit();
+        return true;
+    }
+
+    // Verse v folded, with its map back to the original text
+    FoldedView verse(uint32_t v) const {
+        return { std::string_view(text_.data() + start_[v], start_[v + 1] - start_[v] - 1),
+                 anchors_.data() + anchorStart_[v], anchorStart_[v + 1] - anchorStart_[v] };
+    }
+
+    size_t bytes() const {
+        return text_.capacity() + anchors_.capacity() * sizeof(FoldAnchor)
+               + (start_.capacity() + anchorStart_.capacity()) * sizeof(uint32_t);
+    }
+
+    // Whether verse v contains needle (folded)
+    bool contains(uint32_t v, std::string_view needle) const {
+        return findFolded(text_.data() + start_[v], start_[v + 1] - start_[v] - 1, needle) != SCAN_NOT_FOUND;
+    }
+
+    // Call fn(verse) once for every verse in [first, last) that contains
+    // needle, in ascending order. needle must already be folded.
+    template <class Fn>
+    void forEachMatch(std::string_view needle, uint32_t first, uint32_t last, Fn fn) const {
+        if (needle.empty() || first >= last) return;
+        const FindFoldedFn find = findFoldedKernel();
+        size_t pos = start_[first];
+        const size_t end = start_[last];
+        while (pos < end) {
+            size_t hit = find(text_.data() + pos, end - pos, needle);
+            if (hit == SCAN_NOT_FOUND) return;
+            uint32_t v = std::upper_bound(start_.begin() + first, start_.begin() + last + 1, uint32_t(pos + hit))
+                - start_.begin() - 1;
+            fn(v);
+            pos = start_[v + 1];
+        }
+    }
+
+private:
+    std::string text_;               // folded verse texts, each NUL-terminated
+    std::vector<uint32_t> start_;    // verseCount + 1 offsets into text_
+    std::vector<FoldAnchor> anchors_;        // each verse's, relative to it
+    std::vector<uint32_t> anchorStart_;      // verseCount + 1 offsets into anchors_
+};
+
+#endif // NABRETERM_TEXT_SCAN_HPP
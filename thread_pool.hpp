@@ -0,0 +1,178 @@
+// thread_pool.hpp
+// Small work-stealing thread pool shared by the search paths.
+//
+// Every worker owns a deque: it takes its own work from the back and, when
+// that runs dry, steals from the front of the other deques, so uneven shards
+// (a long book next to a short one) still keep every core busy.
+// parallelFor() hands each chunk its index, which lets callers collect
+// results in per-chunk buffers and merge them back in order, so output never
+// depends on scheduling. Its chunks are claimed from a counter of their own
+// by the caller and by helper tasks, so a caller that is itself a pool task
+// (a --batch line) only ever runs its own chunks, never another queued task.
+#ifndef NABRETERM_THREAD_POOL_HPP
+#define NABRETERM_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // workers == 0 runs everything on the calling thread
+    explicit ThreadPool(unsigned workers) {
+        queues_.resize(std::max(1u, workers));
+        for (auto& q : queues_) q = std::make_unique<Queue>();
+        for (unsigned i = 0; i < workers; i++) threads_.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queued tasks that have not started are dropped
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+
+    // Threads that take part in parallelFor (the workers plus the caller)
+    unsigned concurrency() const { return threads_.size() + 1; }
+
+    // Default --threads value
+    static unsigned defaultThreads() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Run task asynchronously on a worker (inline when there are none)
+    void submit(std::function<void()> task) {
+        if (threads_.empty()) {
+            task();
+            return;
+        }
+        push(next_++ % queues_.size(), std::move(task));
+    }
+
+    // Call fn(begin, end, chunk) for consecutive chunks of [0, count) of at
+    // most grain items. The caller runs chunks too and returns when all of
+    // them are done; it is safe to call from inside a pool task.
+    template <class Fn>
+    void parallelFor(size_t count, size_t grain, Fn&& fn) {
+        if (count == 0) return;
+        grain = std::max<size_t>(grain, 1);
+        const size_t chunks = (count + grain - 1) / grain;
+        if (threads_.empty() || chunks == 1) {
+            for (size_t c = 0; c < chunks; c++) fn(c * grain, std::min(count, (c + 1) * grain), c);
+            return;
+        }
+
+        // A helper that starts after the last chunk was claimed returns
+        // without touching fn, so the group may outlive this call. Whoever
+        // finishes the last chunk wakes the caller, which blocks rather
+        // than spinning while other callers' chunks need the cores.
+        struct Group {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> remaining{0};
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        auto group = std::make_shared<Group>();
+        group->remaining.store(chunks, std::memory_order_relaxed);
+        auto claim = [group, chunks, count, grain, &fn] {
+            for (size_t c; (c = group->next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+                fn(c * grain, std::min(count, (c + 1) * grain), c);
+                if (group->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(group->mutex);
+                    group->done.notify_all();
+                }
+            }
+        };
+        const size_t helpers = std::min(chunks - 1, threads_.size());
+        for (size_t h = 0; h < helpers; h++) push(next_++ % queues_.size(), claim);
+        claim();
+        std::unique_lock<std::mutex> lock(group->mutex);
+        group->done.wait(lock, [&] { return group->remaining.load(std::memory_order_acquire) == 0; });
+    }
+
+    // Chunk size that gives each thread several chunks to balance with
+    size_t grainFor(size_t count, size_t minimum = 64) const {
+        return std::max(minimum, count / (concurrency() * 8) + 1);
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void push(size_t q, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+            queues_[q]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            pending_++;
+        }
+        wake_.notify_one();
+    }
+
+    // Own queue from the back, other queues (stealing) from the front
+    bool pop(size_t self, std::function<void()>& task) {
+        const size_t n = queues_.size();
+        for (size_t k = 0; k < n; k++) {
+            Queue& q = *queues_[(self + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            if (k == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            } else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne(size_t self) {
+        std::function<void()> task;
+        if (!pop(self, task)) return false;
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            pending_--;
+        }
+        task();
+        return true;
+    }
+
+    void workerLoop(size_t self) {
+        while (true) {
+            if (runOne(self)) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wake_.wait(lock, [this] { return stop_ || pending_ > 0; });
+            if (stop_) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{0};
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    size_t pending_ = 0;
+    bool stop_ = false;
+};
+
+#endif // NABRETERM_THREAD_POOL_HPP
@@ -0,0 +1,109 @@
+// verse_sampler.hpp
+// Uniform random verses for `random`, drawn from load-time tables.
+//
+// Every scope (the whole Bible, a named group of books, one book) is sampled
+// by verse rather than book-then-chapter-then-verse, so a short book is only
+// as likely as its share of the verses. A named scope is its books and the
+// running total of their verse counts: a draw is one random number and a
+// binary search, never a copy of the books. A book's verses are contiguous,
+// so a single-book scope needs no table at all. Several verses of a chapter
+// come from a partial Fisher-Yates shuffle, without a retry loop.
+#ifndef NABRETERM_VERSE_SAMPLER_HPP
+#define NABRETERM_VERSE_SAMPLER_HPP
+
+#include "corpus.hpp"
+#include "reference_index.hpp"   // VerseRange
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class VerseSampler {
+public:
+    static constexpr uint32_t NO_VERSE = UINT32_MAX;
+
+    explicit VerseSampler(uint64_t seed = std::random_device{}()) : rng_(seed) {}
+
+    // The whole corpus becomes scope ""; others are added with addScope()
+    void build(const Corpus& corpus) {
+        corpus_ = &corpus;
+        scopes_.clear();
+        addScope("", [](uint32_t) { return true; });
+    }
+
+    // Scope of the books b with inScope(b)
+    template <class Predicate>
+    void addScope(const std::string& name, Predicate inScope) {
+        Scope& scope = scopes_[name];
+        scope = {};
+        uint64_t total = 0;
+        for (uint32_t b = 0; b < corpus_->bookCount(); b++) {
+            const VerseRange range = bookVerses(b);
+            if (!inScope(b) || range.empty()) continue;
+            total += range.last - range.first;
+            scope.books.push_back(b);
+            scope.cumulative.push_back(total);
+        }
+    }
+
+    bool hasScope(const std::string& name) const { return scopes_.count(name) != 0; }
+
+    // A uniformly random verse of a named scope, NO_VERSE if it has none
+    uint32_t pick(const std::string& name) {
+        auto it = scopes_.find(name);
+        if (it == scopes_.end() || it->second.books.empty()) return NO_VERSE;
+        const Scope& scope = it->second;
+        const uint64_t r = below(scope.cumulative.back());
+        const size_t i = std::upper_bound(scope.cumulative.begin(), scope.cumulative.end(), r)
+                         - scope.cumulative.begin();
+        const uint64_t before = i ? scope.cumulative[i - 1] : 0;
+        return bookVerses(scope.books[i]).first + uint32_t(r - before);
+    }
+
+    // A uniformly random verse of one book, NO_VERSE if it has none
+    uint32_t pickInBook(uint32_t book) {
+        const VerseRange range = bookVerses(book);
+        if (range.empty()) return NO_VERSE;
+        return range.first + uint32_t(below(range.last - range.first));
+    }
+
+    // count distinct verses of a chapter in random order (count must not
+    // exceed its verse count); the scratch buffer is reused between calls
+    const std::vector<uint32_t>& pickInChapter(uint32_t chapter, uint32_t count) {
+        const ChapterRecord& ch = corpus_->chapter(chapter);
+        order_.resize(ch.verseCount);
+        for (uint32_t i = 0; i < ch.verseCount; i++) order_[i] = ch.firstVerse + i;
+        for (uint32_t i = 0; i < count; i++) std::swap(order_[i], order_[i + below(ch.verseCount - i)]);
+        order_.resize(count);
+        return order_;
+    }
+
+private:
+    struct Scope {
+        std::vector<uint32_t> books;
+        std::vector<uint64_t> cumulative;   // verses in books[0..i]
+    };
+
+    VerseRange bookVerses(uint32_t b) const {
+        const BookRecord& book = corpus_->book(b);
+        if (book.chapterCount == 0) return {};
+        const ChapterRecord& last = corpus_->chapter(book.firstChapter + book.chapterCount - 1);
+        return { corpus_->chapter(book.firstChapter).firstVerse, last.firstVerse + last.verseCount };
+    }
+
+    // Uniform in [0, n)
+    uint64_t below(uint64_t n) {
+        return std::uniform_int_distribution<uint64_t>(0, n - 1)(rng_);
+    }
+
+    const Corpus* corpus_ = nullptr;
+    std::unordered_map<std::string, Scope> scopes_;
+    std::vector<uint32_t> order_;
+    std::mt19937_64 rng_;
+};
+
+#endif // NABRETERM_VERSE_SAMPLER_HPP